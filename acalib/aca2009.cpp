@@ -130,6 +130,28 @@ void stats_print()
     }
 }
 
+void stats_get(uint32_t cpuid, int counters[4])
+{
+    if(cpuid < num_cpus && stats_percpu != NULL)
+    {
+        counters[0] = stats_percpu[cpuid].writehit;
+        counters[1] = stats_percpu[cpuid].writemiss;
+        counters[2] = stats_percpu[cpuid].readhit;
+        counters[3] = stats_percpu[cpuid].readmiss;
+    }
+}
+
+void stats_set(uint32_t cpuid, const int counters[4])
+{
+    if(cpuid < num_cpus && stats_percpu != NULL)
+    {
+        stats_percpu[cpuid].writehit  = counters[0];
+        stats_percpu[cpuid].writemiss = counters[1];
+        stats_percpu[cpuid].readhit   = counters[2];
+        stats_percpu[cpuid].readmiss  = counters[3];
+    }
+}
+
 void stats_writehit(uint32_t cpuid)
 {
     if(cpuid < num_cpus && stats_percpu != NULL)
@@ -285,3 +307,40 @@ bool TraceFile::eof() const
     return (m_num_finished == m_positions.size());
 }
 
+bool TraceFile::finished(uint32_t pid) const
+{
+    return (m_positions[pid] == (std::streampos) 0);
+}
+
+vector<uint64_t> TraceFile::get_positions() const
+{
+    vector<uint64_t> positions(m_positions.size());
+    for(size_t i = 0; i < m_positions.size(); i++)
+    {
+        positions[i] = (streamoff) m_positions[i];
+    }
+    return positions;
+}
+
+void TraceFile::set_positions(const vector<uint64_t>& positions)
+{
+    if(positions.size() != m_positions.size())
+    {
+        throw runtime_error("Trace positions do not match the number of processors");
+    }
+
+    m_num_finished = 0;
+    for(size_t i = 0; i < positions.size(); i++)
+    {
+        if(positions[i] >= (uint64_t) (streamoff) m_endstream)
+        {
+            throw runtime_error("Trace position beyond the end of the file");
+        }
+        m_positions[i] = (streamoff) positions[i];
+        if(positions[i] == 0)
+        {
+            m_num_finished++;
+        }
+    }
+}
+
@@ -83,6 +83,11 @@ void stats_writemiss(uint32_t cpuid);
 void stats_readhit(uint32_t cpuid);
 void stats_readmiss(uint32_t cpuid);
 
+// Reads or overwrites the statistic counters of given CPU, for checkpoints.
+// The counters are writehit, writemiss, readhit and readmiss, in order.
+void stats_get(uint32_t cpuid, int counters[4]);
+void stats_set(uint32_t cpuid, const int counters[4]);
+
 class TraceFile 
 {
 public:
@@ -119,6 +124,14 @@ public:
     // Determines if the end-of-file has been reached
     bool eof() const;
 
+    // Determines if the trace of processor pid has ended
+    bool finished(uint32_t pid) const;
+
+    // Reads or restores the file offsets of the next entry per processor,
+    // 0 for an ended trace
+    std::vector<uint64_t> get_positions() const;
+    void set_positions(const std::vector<uint64_t>& positions);
+
     // Returns the number of processors this file contains traces for
     uint32_t get_proc_count() const;
 
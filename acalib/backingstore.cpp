@@ -0,0 +1,185 @@
+/*
+// File: backingstore.cpp
+//
+// Source file for the sparse backing store, see backingstore.h.
+*/
+
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
+#include "backingstore.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+// Pages per chunk of the pool, 256 KiB
+static const size_t PAGES_PER_CHUNK = 64;
+
+PagePool::PagePool(size_t block_size, size_t blocks_per_chunk)
+    : m_block_size(block_size), m_blocks_per_chunk(blocks_per_chunk),
+      m_next(blocks_per_chunk), m_used(0)
+{
+}
+
+PagePool::~PagePool()
+{
+    for (size_t i = 0; i < m_chunks.size(); i++)
+    {
+        ::free(m_chunks[i]);
+    }
+}
+
+void* PagePool::allocate()
+{
+    void* block;
+    if (!m_free.empty())
+    {
+        block = m_free.back();
+        m_free.pop_back();
+        memset(block, 0, m_block_size);
+    }
+    else
+    {
+        if (m_next == m_blocks_per_chunk)
+        {
+            // calloc leaves the pages of a fresh chunk to the system until
+            // they are touched
+            char* chunk = (char*) calloc(m_blocks_per_chunk, m_block_size);
+            if (chunk == NULL)
+            {
+                throw bad_alloc();
+            }
+            m_chunks.push_back(chunk);
+            m_next = 0;
+        }
+        block = m_chunks.back() + m_next++ * m_block_size;
+    }
+    m_used++;
+    return block;
+}
+
+void PagePool::free(void* block)
+{
+    m_free.push_back(block);
+    m_used--;
+}
+
+BackingStore::BackingStore()
+    : m_directory(TABLE_SIZE), m_pages(PAGE_SIZE, PAGES_PER_CHUNK), m_tables(0)
+{
+}
+
+BackingStore::~BackingStore()
+{
+    for (size_t i = 0; i < m_directory.size(); i++)
+    {
+        delete m_directory[i];
+    }
+}
+
+uint8_t* BackingStore::allocate(uint32_t addr)
+{
+    Table*& table = m_directory[addr >> (32 - TABLE_BITS)];
+    if (table == NULL)
+    {
+        table = new Table();
+        m_tables++;
+    }
+    uint8_t*& page = table->pages[(addr >> PAGE_BITS) & (TABLE_SIZE - 1)];
+    page = (uint8_t*) m_pages.allocate();
+    return page;
+}
+
+void BackingStore::read(uint32_t addr, void* data, uint32_t size) const
+{
+    uint8_t* out = (uint8_t*) data;
+    while (size > 0)
+    {
+        uint32_t       offset = addr & (PAGE_SIZE - 1);
+        uint32_t       n      = min(size, PAGE_SIZE - offset);
+        const uint8_t* p      = find(addr);
+        if (p != NULL)
+            memcpy(out, p + offset, n);
+        else
+            memset(out, 0, n);
+        addr += n;
+        out  += n;
+        size -= n;
+    }
+}
+
+void BackingStore::write(uint32_t addr, const void* data, uint32_t size)
+{
+    const uint8_t* in = (const uint8_t*) data;
+    while (size > 0)
+    {
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        uint32_t n      = min(size, PAGE_SIZE - offset);
+        memcpy(page(addr) + offset, in, n);
+        addr += n;
+        in   += n;
+        size -= n;
+    }
+}
+
+uint64_t BackingStore::footprint() const
+{
+    return m_pages.reserved() + (uint64_t) m_tables * sizeof(Table) +
+           m_directory.size() * sizeof(Table*);
+}
+
+void BackingStore::clear()
+{
+    for (size_t i = 0; i < m_directory.size(); i++)
+    {
+        Table* table = m_directory[i];
+        if (table == NULL)
+        {
+            continue;
+        }
+        for (uint32_t j = 0; j < TABLE_SIZE; j++)
+        {
+            if (table->pages[j] != NULL)
+            {
+                m_pages.free(table->pages[j]);
+            }
+        }
+        delete table;
+        m_directory[i] = NULL;
+    }
+    m_tables = 0;
+}
+
+void BackingStore::save(CheckpointWriter& out) const
+{
+    out.section("MEMO");
+    out.put((uint64_t) pages());
+    for (uint32_t i = 0; i < m_directory.size(); i++)
+    {
+        const Table* table = m_directory[i];
+        for (uint32_t j = 0; table != NULL && j < TABLE_SIZE; j++)
+        {
+            if (table->pages[j] != NULL)
+            {
+                out.put((i << TABLE_BITS) | j);
+                out.put(table->pages[j], PAGE_SIZE);
+            }
+        }
+    }
+}
+
+void BackingStore::load(CheckpointReader& in)
+{
+    in.section("MEMO");
+    clear();
+    uint64_t n = in.get<uint64_t>();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        uint32_t number = in.get<uint32_t>();
+        if (number >= (1u << (32 - PAGE_BITS)))
+        {
+            in.fail("invalid page number");
+        }
+        in.get(page(number << PAGE_BITS), PAGE_SIZE);
+    }
+}
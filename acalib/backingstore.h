@@ -0,0 +1,140 @@
+/*
+// File: backingstore.h
+//
+// Header file for the sparse backing store of main memory. It covers the
+// whole 32-bit address space in pages of 4 KiB, which are only allocated
+// when first written, so memory use follows the footprint of a trace and
+// not its address range. Unwritten memory reads as zero.
+//
+// Pages are found through a two-level table, 1024 directory entries of
+// 1024 pages each, and come from a PagePool that carves them out of large
+// zeroed chunks, so a trace touching many pages costs one allocation per
+// chunk instead of one per page.
+//
+// Words are stored in host byte order, at addresses rounded down to a
+// multiple of four.
+//
+// Usage:
+//   BackingStore mem;
+//   mem.write_word(0x80001000, 42);
+//   mem.read(line_addr, buffer, 32);     // whole lines for a cache fill
+*/
+
+#ifndef BACKINGSTORE_H
+#define BACKINGSTORE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Fixed-size zeroed blocks, allocated chunk by chunk and never returned to
+// the system before the pool is destroyed
+class PagePool
+{
+public:
+    PagePool(size_t block_size, size_t blocks_per_chunk);
+    ~PagePool();
+
+    // Returns a zeroed block, throws bad_alloc when out of memory
+    void* allocate();
+
+    // Returns a block to the pool
+    void free(void* block);
+
+    size_t block_size() const { return m_block_size; }
+
+    // Blocks handed out and not freed
+    size_t used() const { return m_used; }
+
+    // Bytes allocated from the system
+    size_t reserved() const { return m_chunks.size() * m_block_size * m_blocks_per_chunk; }
+
+private:
+    size_t             m_block_size;
+    size_t             m_blocks_per_chunk;
+    std::vector<char*> m_chunks;
+    std::vector<void*> m_free;
+    size_t             m_next;      // next unused block of the last chunk
+    size_t             m_used;
+
+    // Private copy constructor because no copies are allowed.
+    PagePool(const PagePool&);
+};
+
+class BackingStore
+{
+public:
+    static const uint32_t PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+    BackingStore();
+    ~BackingStore();
+
+    uint32_t read_word(uint32_t addr) const
+    {
+        const uint8_t* page = find(addr);
+        uint32_t       value = 0;
+        if (page != NULL)
+        {
+            memcpy(&value, page + (addr & (PAGE_SIZE - 4)), sizeof(value));
+        }
+        return value;
+    }
+
+    void write_word(uint32_t addr, uint32_t value)
+    {
+        memcpy(page(addr) + (addr & (PAGE_SIZE - 4)), &value, sizeof(value));
+    }
+
+    // Copies size bytes from or to memory, wrapping at the end of the
+    // address space
+    void read(uint32_t addr, void* data, uint32_t size) const;
+    void write(uint32_t addr, const void* data, uint32_t size);
+
+    // Pages allocated, and bytes used by pages and tables
+    size_t   pages() const { return m_pages.used(); }
+    uint64_t footprint() const;
+
+    // Frees all pages, memory reads as zero again
+    void clear();
+
+    // Writes or restores the allocated pages
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    static const uint32_t TABLE_BITS = (32 - PAGE_BITS) / 2;
+    static const uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+
+    struct Table
+    {
+        uint8_t* pages[TABLE_SIZE];
+    };
+
+    std::vector<Table*> m_directory;    // TABLE_SIZE entries, NULL if empty
+    PagePool            m_pages;
+    size_t              m_tables;
+
+    const uint8_t* find(uint32_t addr) const
+    {
+        const Table* table = m_directory[addr >> (32 - TABLE_BITS)];
+        return (table == NULL) ? NULL : table->pages[(addr >> PAGE_BITS) & (TABLE_SIZE - 1)];
+    }
+
+    // Returns the page of addr, allocating it if needed
+    uint8_t* page(uint32_t addr)
+    {
+        uint8_t* p = const_cast<uint8_t*>(find(addr));
+        return (p != NULL) ? p : allocate(addr);
+    }
+
+    uint8_t* allocate(uint32_t addr);
+
+    // Private copy constructor because no copies are allowed.
+    BackingStore(const BackingStore&);
+};
+
+#endif
@@ -0,0 +1,26 @@
+/*
+// File: bustrace.cpp
+//
+// Source file for the bus trace writer, see bustrace.h.
+*/
+
+#include "bustrace.h"
+
+using namespace std;
+
+BusTraceWriter::BusTraceWriter(const char* filename, uint32_t procs)
+    : m_streams(filename, procs), m_next(procs, 0), m_requests(0)
+{
+}
+
+void BusTraceWriter::request(uint32_t cpu, uint64_t cycle, uint32_t addr, bool write)
+{
+    uint64_t& next = m_next[cpu];
+    for (; next < cycle; next++)
+    {
+        m_streams.write(cpu, TraceFile::ENTRY_TYPE_NOP);
+    }
+    m_streams.write(cpu, write ? TraceFile::ENTRY_TYPE_WRITE : TraceFile::ENTRY_TYPE_READ, addr);
+    next++;
+    m_requests++;
+}
@@ -0,0 +1,52 @@
+/*
+// File: bustrace.h
+//
+// Header file for the bus trace writer. A simulator appends the requests
+// its caches put on the bus (misses and write-backs) per CPU, stamped with
+// the cycle they were granted, and the result is a regular 2TRF tracefile
+// that can drive a study of the levels below the caches directly.
+//
+// Every CPU's stream keeps its timing: the cycles between two requests are
+// filled with NOP entries, which a trace-driven CPU spends one cycle each
+// on. Requests of a CPU in the same cycle follow each other directly.
+//
+// The streams are written through a StreamTraceWriter, which spills each
+// to its own temporary file, <filename>.<cpu>, and close() merges them into
+// <filename>, ending every stream with an end entry.
+*/
+
+#ifndef BUSTRACE_H
+#define BUSTRACE_H
+
+#include <stdint.h>
+#include <vector>
+#include "tracewriter.h"
+
+class BusTraceWriter
+{
+public:
+    // Creates the spill files, throws runtime_error on failure
+    BusTraceWriter(const char* filename, uint32_t procs);
+
+    // Appends a request of cpu granted in the given cycle
+    void request(uint32_t cpu, uint64_t cycle, uint32_t addr, bool write);
+
+    // Writes the tracefile and removes the spill files
+    void close() { m_streams.close(); }
+
+    // Entries per CPU, NOPs included
+    uint64_t entries(uint32_t cpu) const { return m_streams.entries(cpu); }
+
+    // Requests over all CPUs
+    uint64_t requests() const { return m_requests; }
+
+private:
+    StreamTraceWriter     m_streams;
+    std::vector<uint64_t> m_next;       // first cycle not covered per stream
+    uint64_t              m_requests;
+
+    // Private copy constructor because no copies are allowed.
+    BusTraceWriter(const BusTraceWriter&);
+};
+
+#endif
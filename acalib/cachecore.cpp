@@ -0,0 +1,244 @@
+/*
+// File: cachecore.cpp
+//
+// Source file for the functional cache model, see cachecore.h.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include "cachecore.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+// Returns log2(v), or -1 if v is not a power of two
+static int log2_exact(uint32_t v)
+{
+    if (v == 0 || (v & (v - 1)) != 0)
+    {
+        return -1;
+    }
+    int n = 0;
+    while (v > 1)
+    {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+ReplacementPolicy parse_policy(const string& name)
+{
+    if (name == "lru")    return REPL_LRU;
+    if (name == "fifo")   return REPL_FIFO;
+    if (name == "plru")   return REPL_PLRU;
+    if (name == "random") return REPL_RANDOM;
+    throw runtime_error("Unknown replacement policy: " + name);
+}
+
+const char* policy_name(ReplacementPolicy policy)
+{
+    static const char* const names[] = { "lru", "fifo", "plru", "random" };
+    return names[policy];
+}
+
+void CacheCore::validate(uint32_t sets, uint32_t ways, uint32_t line_size, ReplacementPolicy policy)
+{
+    int set_bits  = log2_exact(sets);
+    int line_bits = log2_exact(line_size);
+    if (set_bits < 0 || line_bits < 0 || set_bits + line_bits >= 32)
+    {
+        throw runtime_error("Cache sets and line size must be powers of two");
+    }
+    if (ways == 0 || ways > 255)
+    {
+        throw runtime_error("Cache associativity must be between 1 and 255");
+    }
+    if (policy == REPL_PLRU && (log2_exact(ways) < 0 || ways > 64))
+    {
+        throw runtime_error("Pseudo-LRU needs a power of two ways, up to 64");
+    }
+}
+
+CacheCore::CacheCore(uint32_t sets, uint32_t ways, uint32_t line_size, ReplacementPolicy policy,
+                     bool line_data)
+    : m_sets(sets), m_ways(ways), m_policy(policy)
+{
+    validate(sets, ways, line_size, policy);
+    int set_bits  = log2_exact(sets);
+    int line_bits = log2_exact(line_size);
+    m_line_bits = line_bits;
+    m_tag_shift = set_bits + line_bits;
+
+    // Valid and dirty bits come first, then the pseudo-LRU tree, then the
+    // LRU/FIFO list with a byte per way and the tags, each from a new word
+    uint32_t plru_bits = (policy == REPL_PLRU) ? ways - 1 : 0;
+    uint32_t order     = (policy == REPL_LRU || policy == REPL_FIFO) ? ways : 0;
+    m_valid_pos  = 0;
+    m_dirty_pos  = ways;
+    m_plru_pos   = 2 * ways;
+    m_order_word = (m_plru_pos + plru_bits + 63) / 64;
+
+    // Tags take the smallest whole bytes that hold them
+    uint32_t tag_bits = 32 - m_tag_shift;
+    m_tag_bytes = (tag_bits <= 8) ? 1 : (tag_bits <= 16) ? 2 : 4;
+    m_tag_word  = m_order_word + (order + 7) / 8;
+    m_stride    = m_tag_word + (ways * m_tag_bytes + 7) / 8;
+
+    m_meta.resize((size_t) sets * m_stride);
+    if (line_data)
+    {
+        m_data.resize((size_t) sets * ways * line_size);
+    }
+    clear();
+}
+
+void CacheCore::clear()
+{
+    fill(m_meta.begin(), m_meta.end(), 0);
+    if (m_policy == REPL_LRU || m_policy == REPL_FIFO)
+    {
+        for (uint32_t s = 0; s < m_sets; s++)
+        {
+            uint8_t* order = lru_order(s);
+            for (uint32_t w = 0; w < m_ways; w++)
+            {
+                order[w] = w;
+            }
+        }
+    }
+    fill(m_data.begin(), m_data.end(), 0);
+    m_random = 0x9E3779B9;
+}
+
+void CacheCore::save(CheckpointWriter& out) const
+{
+    out.section("CORE");
+    out.put(m_sets);
+    out.put(m_ways);
+    out.put(m_line_bits);
+    out.put((uint32_t) m_policy);
+    out.put(m_random);
+    out.put_vector(m_meta);
+    out.put_vector(m_data);
+}
+
+void CacheCore::load(CheckpointReader& in)
+{
+    in.section("CORE");
+    if (in.get<uint32_t>() != m_sets || in.get<uint32_t>() != m_ways ||
+        in.get<uint32_t>() != m_line_bits || in.get<uint32_t>() != (uint32_t) m_policy)
+    {
+        in.fail("different cache geometry or policy");
+    }
+    in.get(m_random);
+    in.get_vector(m_meta, m_meta.size());
+    if (in.get<uint64_t>() != m_data.size())
+    {
+        in.fail("line data does not match");
+    }
+    if (!m_data.empty())
+    {
+        in.get(&m_data[0], m_data.size());
+    }
+}
+
+void CacheCore::update(uint32_t set, uint32_t way)
+{
+    if (m_policy == REPL_PLRU)
+    {
+        // Walk from the root to the leaf of way, pointing every node on the
+        // path away from it. Node n has children 2n+1 and 2n+2.
+        uint64_t* p    = meta(set);
+        uint32_t  node = 0;
+        for (uint32_t half = m_ways / 2; half > 0; half /= 2)
+        {
+            bool right = (way & half) != 0;
+            put_bits(p, m_plru_pos + node, 1, right ? 0 : 1);
+            node = 2 * node + (right ? 2 : 1);
+        }
+        return;
+    }
+
+    uint8_t* order = lru_order(set);
+
+    // Shift the more recently used ways down, way goes in front
+    uint32_t i = 0;
+    while (order[i] != way)
+    {
+        i++;
+    }
+    for (; i > 0; i--)
+    {
+        order[i] = order[i - 1];
+    }
+    order[0] = way;
+}
+
+uint32_t CacheCore::victim(uint32_t set)
+{
+    const uint64_t* p = meta(set);
+    switch (m_policy)
+    {
+    case REPL_PLRU:
+    {
+        // Follow the bits, a set bit means the left side was used last
+        uint32_t node = 0, way = 0;
+        for (uint32_t half = m_ways / 2; half > 0; half /= 2)
+        {
+            bool right = get_bit(p, m_plru_pos + node);
+            if (right)
+                way |= half;
+            node = 2 * node + (right ? 2 : 1);
+        }
+        return way;
+    }
+
+    case REPL_RANDOM:
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 17;
+        m_random ^= m_random << 5;
+        return m_random % m_ways;
+
+    default:
+        return lru_order(set)[m_ways - 1];
+    }
+}
+
+uint32_t CacheCore::allocate(uint32_t set, uint32_t tag, uint32_t* replaced, bool* dirty)
+{
+    uint64_t* p = meta(set);
+    uint32_t  way;
+    if (entries(set) < m_ways)
+    {
+        // Use the first invalid way
+        for (way = 0; get_bit(p, m_valid_pos + way); way++)
+        {
+        }
+        if (dirty != 0)
+        {
+            *dirty = false;
+        }
+    }
+    else
+    {
+        way = victim(set);
+        if (replaced != 0)
+        {
+            *replaced = get_tag(p, way);
+        }
+        if (dirty != 0)
+        {
+            *dirty = get_bit(p, m_dirty_pos + way);
+        }
+    }
+
+    put_bits(p, m_valid_pos + way, 1, 1);
+    put_bits(p, m_dirty_pos + way, 1, 0);
+    put_tag(p, way, tag);
+    if (m_policy != REPL_RANDOM)
+    {
+        update(set, way);
+    }
+    return way;
+}
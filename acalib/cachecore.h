@@ -0,0 +1,299 @@
+/*
+// File: cachecore.h
+//
+// Header file for the functional model of a set-associative cache. It
+// holds the sets, lines and replacement state, and has no notion of time,
+// so it is shared by the SystemC cache controller and by the untimed
+// simulators.
+//
+// Addresses are split into | tag | set index | line offset |, with the
+// number of sets and the line size powers of two. Lines stay in the way
+// they were filled in; the replacement state of every set is kept
+// separately. For LRU and FIFO that is a list of ways, most recently used
+// (or filled) first; pseudo-LRU uses the tree bits of doc/pseudo_lru.txt.
+//
+// The metadata of a set is packed into a few consecutive 64-bit words, so
+// that large caches stay small and a lookup touches one host cache line:
+//
+//   | valid bits | dirty bits | pseudo-LRU tree | LRU/FIFO list | tags |
+//
+// with one valid and one dirty bit per way and the ways - 1 tree bits of
+// pseudo-LRU, then from the next word on the LRU/FIFO list at a byte per
+// way, and the tags at 8, 16 or 32 bits each, the least that holds the
+// bits the address leaves for them. The list and the tags are kept to
+// whole bytes so that lookups and updates use plain loads and stores. A
+// line is invalid, valid and clean, or valid and dirty; these are also the
+// states a snooping protocol needs.
+//
+// A cache built with line data holds line_size bytes per line, for models
+// that move the contents of memory; the others only keep tags.
+*/
+
+#ifndef CACHECORE_H
+#define CACHECORE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Replacement policies
+enum ReplacementPolicy
+{
+    REPL_LRU,
+    REPL_FIFO,
+    REPL_PLRU,      // tree pseudo-LRU, needs a power of two ways up to 64
+    REPL_RANDOM
+};
+
+// Parses "lru", "fifo", "plru" or "random", throws runtime_error otherwise
+ReplacementPolicy parse_policy(const std::string& name);
+const char* policy_name(ReplacementPolicy policy);
+
+class CacheCore
+{
+public:
+    // Outcome of access()
+    struct Result
+    {
+        bool     hit;
+        uint32_t set;
+        uint32_t way;
+        uint32_t entries;   // valid lines in the set before the access
+        bool     evicted;   // a miss replaced a valid line ...
+        uint32_t victim;    // ... with this tag
+    };
+
+    // Throws runtime_error when sets or line_size is not a power of two
+    CacheCore(uint32_t sets = 128, uint32_t ways = 8, uint32_t line_size = 32,
+              ReplacementPolicy policy = REPL_LRU, bool line_data = false);
+
+    // Checks a geometry and policy as the constructor does, without
+    // allocating anything
+    static void validate(uint32_t sets, uint32_t ways, uint32_t line_size, ReplacementPolicy policy);
+
+    uint32_t num_sets() const  { return m_sets; }
+    uint32_t num_ways() const  { return m_ways; }
+    uint32_t line_size() const { return 1u << m_line_bits; }
+    ReplacementPolicy policy() const { return m_policy; }
+
+    // Address decoding
+    uint32_t index(uint32_t addr) const { return (addr >> m_line_bits) & (m_sets - 1); }
+    uint32_t tag(uint32_t addr) const   { return addr >> m_tag_shift; }
+
+    // First address of the line with tag in set
+    uint32_t address(uint32_t set, uint32_t tag) const
+    {
+        return (tag << m_tag_shift) | (set << m_line_bits);
+    }
+
+    // Returns the way holding tag in set, or -1
+    int find(uint32_t set, uint32_t tag) const
+    {
+        switch (m_tag_bytes)
+        {
+        case 1:  return find_tag<uint8_t>(meta(set), tag);
+        case 2:  return find_tag<uint16_t>(meta(set), tag);
+        default: return find_tag<uint32_t>(meta(set), tag);
+        }
+    }
+
+    // Number of valid lines in set
+    uint32_t entries(uint32_t set) const
+    {
+        const uint64_t* p = meta(set);
+        uint32_t        n = 0;
+        for (uint32_t w = 0; w < m_ways; w += 64)
+        {
+            n += __builtin_popcountll(get_bits(p, m_valid_pos + w, (m_ways - w < 64) ? m_ways - w : 64));
+        }
+        return n;
+    }
+
+    // State of the line in way of set
+    bool valid(uint32_t set, uint32_t way) const { return get_bit(meta(set), m_valid_pos + way); }
+    bool dirty(uint32_t set, uint32_t way) const { return get_bit(meta(set), m_dirty_pos + way); }
+
+    // Marks a valid line as written since it was filled
+    void set_dirty(uint32_t set, uint32_t way) { put_bits(meta(set), m_dirty_pos + way, 1, 1); }
+
+    // Updates the replacement state of set for a hit on way
+    void touch(uint32_t set, uint32_t way)
+    {
+        if (m_policy != REPL_FIFO && m_policy != REPL_RANDOM)
+        {
+            update(set, way);
+        }
+    }
+
+    // Fills tag into an invalid way of set or else the victim chosen by the
+    // replacement policy, and returns the way. The tag of a replaced valid
+    // line is stored in replaced, and whether it was dirty in dirty, when
+    // given. The line data is left alone, so a dirty line can still be
+    // written back before the new one is read in.
+    uint32_t allocate(uint32_t set, uint32_t tag, uint32_t* replaced = 0, bool* dirty = 0);
+
+    // Looks up addr and updates the set as the timed cache does: a hit
+    // touches the line, a miss allocates it
+    bool access(uint32_t addr, Result* result = 0)
+    {
+        uint32_t s = index(addr);
+        uint32_t t = tag(addr);
+        int      w = find(s, t);
+        bool     hit = (w >= 0);
+        if (result != 0)
+        {
+            result->set     = s;
+            result->entries = entries(s);
+            result->hit     = hit;
+            result->evicted = !hit && result->entries == m_ways;
+        }
+        if (hit)
+        {
+            touch(s, w);
+        }
+        else
+        {
+            w = allocate(s, t, result != 0 ? &result->victim : 0);
+        }
+        if (result != 0)
+        {
+            result->way = w;
+        }
+        return hit;
+    }
+
+    // Contents of a line, only for a cache built with line data
+    bool has_data() const { return !m_data.empty(); }
+    uint8_t*       data(uint32_t set, uint32_t way)       { return &m_data[((size_t) set * m_ways + way) << m_line_bits]; }
+    const uint8_t* data(uint32_t set, uint32_t way) const { return &m_data[((size_t) set * m_ways + way) << m_line_bits]; }
+
+    // Invalidates all lines
+    void clear();
+
+    // Bytes of metadata, without line data
+    size_t metadata_size() const { return m_meta.size() * sizeof(uint64_t); }
+
+    // Writes or restores the lines and replacement state. A restored cache
+    // must have the geometry and policy it was saved with.
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    uint32_t          m_sets;
+    uint32_t          m_ways;
+    uint32_t          m_line_bits;
+    uint32_t          m_tag_shift;
+    ReplacementPolicy m_policy;
+    uint32_t          m_random;     // xorshift state for REPL_RANDOM
+
+    // Bit positions and widths within the words of a set
+    uint32_t          m_valid_pos;
+    uint32_t          m_dirty_pos;
+    uint32_t          m_plru_pos;
+    uint32_t          m_order_word; // first word of the LRU/FIFO list
+    uint32_t          m_tag_word;   // first word of the tags
+    uint32_t          m_tag_bytes;  // per tag
+    uint32_t          m_stride;     // words per set
+
+    std::vector<uint64_t> m_meta;       // m_stride words per set
+    std::vector<uint8_t>  m_data;       // line_size bytes per line, or empty
+
+    uint64_t*       meta(uint32_t set)       { return &m_meta[(size_t) set * m_stride]; }
+    const uint64_t* meta(uint32_t set) const { return &m_meta[(size_t) set * m_stride]; }
+
+    // Ways of set, most recently used (or filled) first
+    uint8_t* lru_order(uint32_t set) { return (uint8_t*) (meta(set) + m_order_word); }
+
+    template <typename T>
+    int find_tag(const uint64_t* p, uint32_t tag) const
+    {
+        const uint8_t* tags = (const uint8_t*) (p + m_tag_word);
+        for (uint32_t w = 0; w < m_ways; w++)
+        {
+            if (load_tag<T>(tags, w) == tag && get_bit(p, m_valid_pos + w))
+            {
+                return w;
+            }
+        }
+        return -1;
+    }
+
+    template <typename T>
+    static uint32_t load_tag(const uint8_t* tags, uint32_t way)
+    {
+        T t;
+        memcpy(&t, tags + way * sizeof(T), sizeof(T));
+        return t;
+    }
+
+    template <typename T>
+    static void store_tag(uint8_t* tags, uint32_t way, uint32_t tag)
+    {
+        T t = tag;
+        memcpy(tags + way * sizeof(T), &t, sizeof(T));
+    }
+
+    uint32_t get_tag(const uint64_t* p, uint32_t way) const
+    {
+        const uint8_t* tags = (const uint8_t*) (p + m_tag_word);
+        switch (m_tag_bytes)
+        {
+        case 1:  return load_tag<uint8_t>(tags, way);
+        case 2:  return load_tag<uint16_t>(tags, way);
+        default: return load_tag<uint32_t>(tags, way);
+        }
+    }
+
+    void put_tag(uint64_t* p, uint32_t way, uint32_t tag)
+    {
+        uint8_t* tags = (uint8_t*) (p + m_tag_word);
+        switch (m_tag_bytes)
+        {
+        case 1:  store_tag<uint8_t>(tags, way, tag);  break;
+        case 2:  store_tag<uint16_t>(tags, way, tag); break;
+        default: store_tag<uint32_t>(tags, way, tag); break;
+        }
+    }
+
+    static bool get_bit(const uint64_t* p, uint32_t pos)
+    {
+        return (p[pos / 64] >> (pos % 64)) & 1;
+    }
+
+    // Field of width bits, 1 to 64, at bit pos of p
+    static uint64_t get_bits(const uint64_t* p, uint32_t pos, uint32_t width)
+    {
+        uint32_t shift = pos % 64;
+        uint64_t v     = p[pos / 64] >> shift;
+        if (shift + width > 64)
+        {
+            v |= p[pos / 64 + 1] << (64 - shift);
+        }
+        return (width == 64) ? v : v & ((1ULL << width) - 1);
+    }
+
+    static void put_bits(uint64_t* p, uint32_t pos, uint32_t width, uint64_t value)
+    {
+        uint64_t mask  = (width == 64) ? ~0ULL : (1ULL << width) - 1;
+        uint32_t shift = pos % 64;
+        value &= mask;
+        p[pos / 64] = (p[pos / 64] & ~(mask << shift)) | (value << shift);
+        if (shift + width > 64)
+        {
+            uint32_t done = 64 - shift;
+            p[pos / 64 + 1] = (p[pos / 64 + 1] & ~(mask >> done)) | (value >> done);
+        }
+    }
+
+    // Records a use of way in the replacement state
+    void update(uint32_t set, uint32_t way);
+
+    // Way to evict from a full set
+    uint32_t victim(uint32_t set);
+};
+
+#endif
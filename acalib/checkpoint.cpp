@@ -0,0 +1,106 @@
+/*
+// File: checkpoint.cpp
+//
+// Source file for binary checkpoints, see checkpoint.h.
+*/
+
+#include <stdexcept>
+#include <string.h>
+#include "checkpoint.h"
+
+using namespace std;
+
+static const char     CHECKPOINT_MAGIC[4] = { 'C', 'K', 'P', 'T' };
+static const uint32_t CHECKPOINT_VERSION  = 1;
+
+CheckpointWriter::CheckpointWriter(const char* filename) : m_filename(filename)
+{
+    m_file = fopen(filename, "wb");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to create file: ") + filename);
+    }
+    put(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put(CHECKPOINT_VERSION);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+}
+
+void CheckpointWriter::section(const char* tag)
+{
+    put(tag, 4);
+}
+
+void CheckpointWriter::put(const void* data, size_t size)
+{
+    if (fwrite(data, 1, size, m_file) != size)
+    {
+        throw runtime_error("Unable to write checkpoint: " + m_filename);
+    }
+}
+
+void CheckpointWriter::close()
+{
+    int result = fclose(m_file);
+    m_file = NULL;
+    if (result != 0)
+    {
+        throw runtime_error("Unable to write checkpoint: " + m_filename);
+    }
+}
+
+CheckpointReader::CheckpointReader(const char* filename) : m_filename(filename)
+{
+    m_file = fopen(filename, "rb");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    char magic[4];
+    get(magic, sizeof(magic));
+    if (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+    {
+        fail("not a checkpoint");
+    }
+    if (get<uint32_t>() != CHECKPOINT_VERSION)
+    {
+        fail("unsupported version");
+    }
+}
+
+CheckpointReader::~CheckpointReader()
+{
+    fclose(m_file);
+}
+
+void CheckpointReader::section(const char* tag)
+{
+    char found[4];
+    m_section = tag;
+    get(found, sizeof(found));
+    if (memcmp(found, tag, sizeof(found)) != 0)
+    {
+        fail("section missing");
+    }
+}
+
+void CheckpointReader::get(void* data, size_t size)
+{
+    if (fread(data, 1, size, m_file) != size)
+    {
+        fail("unexpected end of file");
+    }
+}
+
+void CheckpointReader::fail(const string& what) const
+{
+    string where = m_section.empty() ? "" : " (section " + m_section + ")";
+    throw runtime_error("Invalid checkpoint " + m_filename + where + ": " + what);
+}
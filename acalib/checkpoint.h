@@ -0,0 +1,97 @@
+/*
+// File: checkpoint.h
+//
+// Header file for binary checkpoints of the simulator state. A checkpoint
+// is a sequence of sections, each introduced by a four-character tag that
+// is checked on restore, holding raw values in host byte order:
+//
+//   "CKPT" <version u32>
+//   <tag> <data> <tag> <data> ...
+//
+// The file is only meant to be read back by the same build on the same
+// host. Every module writes and reads its own sections, in the same order.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(const char* filename);
+    ~CheckpointWriter();
+
+    // Starts a section, tag has four characters
+    void section(const char* tag);
+
+    void put(const void* data, size_t size);
+
+    template <typename T>
+    void put(const T& value) { put(&value, sizeof(T)); }
+
+    template <typename T>
+    void put_vector(const std::vector<T>& v)
+    {
+        put((uint64_t) v.size());
+        if (!v.empty())
+        {
+            put(&v[0], v.size() * sizeof(T));
+        }
+    }
+
+    // Flushes and closes the file, throws if anything failed
+    void close();
+
+private:
+    FILE*       m_file;
+    std::string m_filename;
+};
+
+class CheckpointReader
+{
+public:
+    explicit CheckpointReader(const char* filename);
+    ~CheckpointReader();
+
+    // Checks that the next section has the given tag
+    void section(const char* tag);
+
+    void get(void* data, size_t size);
+
+    template <typename T>
+    T get() { T value; get(&value, sizeof(T)); return value; }
+
+    template <typename T>
+    void get(T& value) { get(&value, sizeof(T)); }
+
+    // Reads a vector, which must have size elements unless size is 0
+    template <typename T>
+    void get_vector(std::vector<T>& v, uint64_t size = 0)
+    {
+        uint64_t n = get<uint64_t>();
+        if (size != 0 && n != size)
+        {
+            fail("unexpected size");
+        }
+        v.resize(n);
+        if (n > 0)
+        {
+            get(&v[0], n * sizeof(T));
+        }
+    }
+
+    // Throws a runtime_error naming the file and the current section
+    void fail(const std::string& what) const;
+
+private:
+    FILE*       m_file;
+    std::string m_filename;
+    std::string m_section;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+// File: config.cpp
+//
+// Source file for the run-time configuration, see config.h.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include "config.h"
+
+using namespace std;
+
+// Returns s without leading and trailing white space
+static string trim(const string& s)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == string::npos)
+    {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+// Splits "<key>=<value>", returns false if there is no key
+static bool split(const string& assignment, string& key, string& value)
+{
+    size_t eq = assignment.find('=');
+    if (eq == string::npos)
+    {
+        return false;
+    }
+    key   = trim(assignment.substr(0, eq));
+    value = trim(assignment.substr(eq + 1));
+    return !key.empty() && key.find_first_of(" \t") == string::npos;
+}
+
+void Config::load(const char* filename)
+{
+    FILE* f = fopen(filename, "r");
+    if (f == NULL)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    char line[1024];
+    int  number = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        number++;
+        string text = line;
+        size_t hash = text.find('#');
+        if (hash != string::npos)
+        {
+            text.erase(hash);
+        }
+        text = trim(text);
+        if (text.empty())
+        {
+            continue;
+        }
+
+        char origin[32];
+        sprintf(origin, ":%d", number);
+        string key, value;
+        if (!split(text, key, value))
+        {
+            fclose(f);
+            throw runtime_error(filename + string(origin) + ": expected <key> = <value>");
+        }
+        set(key, value, filename + string(origin));
+    }
+    fclose(f);
+}
+
+void Config::set(const string& assignment)
+{
+    string key, value;
+    if (!split(assignment, key, value))
+    {
+        throw runtime_error("Expected <key>=<value>: " + assignment);
+    }
+    set(key, value, "command line");
+}
+
+void Config::set(const string& key, const string& value, const string& origin)
+{
+    Entry e = { value, origin, false };
+    m_entries[key] = e;
+}
+
+uint64_t Config::get_uint(const string& key, uint64_t def, uint64_t min, uint64_t max)
+{
+    const Entry* e = lookup(key);
+    if (e == NULL)
+    {
+        char buf[32];
+        sprintf(buf, "%llu", (unsigned long long) def);
+        use(key, buf);
+        return def;
+    }
+
+    const char* s = e->value.c_str();
+    char*       end;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 0);
+    if (end == s || *end != '\0' || *s == '-' || errno != 0)
+    {
+        throw invalid(key, *e, "not a number");
+    }
+    if (v < min || v > max)
+    {
+        char range[64];
+        sprintf(range, "must be between %llu and %llu", (unsigned long long) min, (unsigned long long) max);
+        throw invalid(key, *e, range);
+    }
+    use(key, e->value);
+    return v;
+}
+
+double Config::get_double(const string& key, double def, double min, double max)
+{
+    const Entry* e = lookup(key);
+    if (e == NULL)
+    {
+        char buf[32];
+        sprintf(buf, "%.17g", def);
+        use(key, buf);
+        return def;
+    }
+
+    const char* s = e->value.c_str();
+    char*       end;
+    double      v = strtod(s, &end);
+    if (end == s || *end != '\0')
+    {
+        throw invalid(key, *e, "not a number");
+    }
+    if (!(v >= min && v <= max))
+    {
+        char range[64];
+        sprintf(range, "must be between %g and %g", min, max);
+        throw invalid(key, *e, range);
+    }
+    use(key, e->value);
+    return v;
+}
+
+string Config::get_string(const string& key, const string& def)
+{
+    const Entry* e = lookup(key);
+    return use(key, (e == NULL) ? def : e->value);
+}
+
+void Config::check_unused() const
+{
+    for (map<string, Entry>::const_iterator p = m_entries.begin(); p != m_entries.end(); ++p)
+    {
+        if (!p->second.used)
+        {
+            throw runtime_error("Unknown parameter " + p->first + " (" + p->second.origin + ")");
+        }
+    }
+}
+
+void Config::write(FILE* f) const
+{
+    for (size_t i = 0; i < m_used.size(); i++)
+    {
+        fprintf(f, "%s = %s\n", m_used[i].first.c_str(), m_used[i].second.c_str());
+    }
+}
+
+const Config::Entry* Config::lookup(const string& key)
+{
+    map<string, Entry>::iterator p = m_entries.find(key);
+    if (p == m_entries.end())
+    {
+        return NULL;
+    }
+    p->second.used = true;
+    return &p->second;
+}
+
+const string& Config::use(const string& key, const string& value)
+{
+    m_used.push_back(make_pair(key, value));
+    return m_used.back().second;
+}
+
+runtime_error Config::invalid(const string& key, const Entry& e, const string& why) const
+{
+    return runtime_error("Invalid " + key + " = " + e.value + " (" + e.origin + "): " + why);
+}
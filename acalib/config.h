@@ -0,0 +1,87 @@
+/*
+// File: config.h
+//
+// Header file for the run-time configuration of a simulator: named
+// parameters read from key/value files and from command-line assignments.
+// A file holds one parameter per line,
+//
+//   # 2 MiB, 16-way
+//   cache.sets = 2048
+//   cache.ways = 16
+//
+// with '#' starting a comment. Later settings replace earlier ones, so a
+// command line can override a file.
+//
+// Values are only checked when the simulator asks for them with a type,
+// a default and a range, which it should do once at startup;
+// check_unused() then rejects the keys nobody asked for, so a misspelt
+// parameter fails the run instead of being ignored.
+//
+// Usage:
+//   Config cfg;
+//   cfg.load("llc.cfg");
+//   cfg.set("cache.ways=4");
+//   uint64_t ways = cfg.get_uint("cache.ways", 8, 1, 255);
+//   cfg.check_unused();
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class Config
+{
+public:
+    // Reads the parameters of a file, throws runtime_error on a line that
+    // is not an assignment
+    void load(const char* filename);
+
+    // Sets a parameter from "<key>=<value>"
+    void set(const std::string& assignment);
+    void set(const std::string& key, const std::string& value, const std::string& origin);
+
+    bool has(const std::string& key) const { return m_entries.count(key) > 0; }
+
+    /*
+     * Returns the value of key, or def when it is not set. Throws
+     * runtime_error when the value is malformed or outside [min, max].
+     */
+    uint64_t    get_uint(const std::string& key, uint64_t def, uint64_t min, uint64_t max);
+    double      get_double(const std::string& key, double def, double min, double max);
+    std::string get_string(const std::string& key, const std::string& def);
+
+    // Throws runtime_error if a parameter was set but never asked for
+    void check_unused() const;
+
+    // Writes every parameter asked for with the value used, one per line
+    // in the format of load()
+    void write(FILE* f) const;
+
+private:
+    struct Entry
+    {
+        std::string value;
+        std::string origin;     // file and line, or the command line
+        bool        used;
+    };
+
+    std::map<std::string, Entry>                     m_entries;
+    std::vector<std::pair<std::string, std::string> > m_used;
+
+    // Value of key for get_*(), NULL if not set
+    const Entry* lookup(const std::string& key);
+
+    // Records the value used for key and returns it
+    const std::string& use(const std::string& key, const std::string& value);
+
+    // Error for a value of key that get_*() cannot use
+    std::runtime_error invalid(const std::string& key, const Entry& e, const std::string& why) const;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+// File: eventlog.cpp
+//
+// Source file for the binary per-access event log, see eventlog.h for the
+// file layout. The writer keeps one block mapped at a time and grows the
+// file a block at a time; the reader maps the whole file.
+*/
+
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eventlog.h"
+
+using namespace std;
+
+static const uint32_t EVENTLOG_VERSION = 1;
+
+// Space reserved for the header, a multiple of any common page size
+static const size_t EVENTLOG_HEADER_SIZE = 65536;
+
+// Widths of the columns, in the order they are stored in a block
+static const size_t EVENTLOG_RECORD_SIZE = 8 + 4 + 4 + 2 + 2 + 1 + 1;
+static const size_t EVENTLOG_BLOCK_SIZE  = EVENTLOG_RECORD_SIZE * EVENTLOG_BLOCK_RECORDS;
+
+// Offsets of the columns within a block
+static const size_t COL_TIME    = 0;
+static const size_t COL_ADDR    = COL_TIME    + 8 * EVENTLOG_BLOCK_RECORDS;
+static const size_t COL_LATENCY = COL_ADDR    + 4 * EVENTLOG_BLOCK_RECORDS;
+static const size_t COL_SET     = COL_LATENCY + 4 * EVENTLOG_BLOCK_RECORDS;
+static const size_t COL_CPU     = COL_SET     + 2 * EVENTLOG_BLOCK_RECORDS;
+static const size_t COL_WAY     = COL_CPU     + 2 * EVENTLOG_BLOCK_RECORDS;
+static const size_t COL_FLAGS   = COL_WAY     + 1 * EVENTLOG_BLOCK_RECORDS;
+
+EventLogWriter::EventLogWriter(const char* filename)
+    : m_filename(filename), m_num_blocks(0), m_index(EVENTLOG_BLOCK_RECORDS), m_block(NULL)
+{
+    m_fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+    {
+        throw runtime_error(string("Unable to create event log: ") + filename);
+    }
+}
+
+EventLogWriter::~EventLogWriter()
+{
+    discard();
+}
+
+void EventLogWriter::discard()
+{
+    if (m_fd >= 0)
+    {
+        unmap_block();
+        ::close(m_fd);
+        m_fd = -1;
+        unlink(m_filename.c_str());
+    }
+}
+
+uint64_t EventLogWriter::size() const
+{
+    if (m_num_blocks == 0)
+    {
+        return 0;
+    }
+    return (m_num_blocks - 1) * EVENTLOG_BLOCK_RECORDS + m_index;
+}
+
+void EventLogWriter::unmap_block()
+{
+    if (m_block != NULL)
+    {
+        munmap(m_block, EVENTLOG_BLOCK_SIZE);
+        m_block = NULL;
+    }
+}
+
+void EventLogWriter::next_block()
+{
+    unmap_block();
+
+    off_t offset = EVENTLOG_HEADER_SIZE + m_num_blocks * EVENTLOG_BLOCK_SIZE;
+    if (ftruncate(m_fd, offset + EVENTLOG_BLOCK_SIZE) != 0)
+    {
+        throw runtime_error("Unable to grow event log");
+    }
+
+    void* p = mmap(NULL, EVENTLOG_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, offset);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error("Unable to map event log");
+    }
+
+    m_block   = (char*) p;
+    m_time    = (uint64_t*) (m_block + COL_TIME);
+    m_addr    = (uint32_t*) (m_block + COL_ADDR);
+    m_latency = (uint32_t*) (m_block + COL_LATENCY);
+    m_set     = (uint16_t*) (m_block + COL_SET);
+    m_cpu     = (uint16_t*) (m_block + COL_CPU);
+    m_way     = (int8_t*)   (m_block + COL_WAY);
+    m_flags   = (uint8_t*)  (m_block + COL_FLAGS);
+    m_index   = 0;
+    m_num_blocks++;
+}
+
+void EventLogWriter::close()
+{
+    if (m_fd < 0)
+    {
+        return;
+    }
+    unmap_block();
+
+    EventLogHeader header;
+    memcpy(header.signature, "EVLG", 4);
+    header.version       = EVENTLOG_VERSION;
+    header.block_records = EVENTLOG_BLOCK_RECORDS;
+    header.record_size   = EVENTLOG_RECORD_SIZE;
+    header.num_records   = size();
+
+    if (m_num_blocks == 0 && ftruncate(m_fd, EVENTLOG_HEADER_SIZE) != 0)
+    {
+        discard();
+        throw runtime_error("Unable to write event log");
+    }
+    if (pwrite(m_fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+    {
+        discard();
+        throw runtime_error("Unable to write event log header");
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+EventLogReader::EventLogReader(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < EVENTLOG_HEADER_SIZE)
+    {
+        ::close(fd);
+        throw runtime_error(string("Invalid event log: ") + filename);
+    }
+    m_length = st.st_size;
+
+    void* p = mmap(NULL, m_length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error(string("Unable to map file: ") + filename);
+    }
+    m_data = (const char*) p;
+
+    const EventLogHeader* header = (const EventLogHeader*) m_data;
+    if (strncmp(header->signature, "EVLG", 4) || header->version != EVENTLOG_VERSION ||
+        header->block_records != EVENTLOG_BLOCK_RECORDS || header->record_size != EVENTLOG_RECORD_SIZE)
+    {
+        munmap((void*) m_data, m_length);
+        throw runtime_error(string("Invalid event log: ") + filename);
+    }
+    m_num_records = header->num_records;
+
+    if (EVENTLOG_HEADER_SIZE + num_blocks() * EVENTLOG_BLOCK_SIZE > m_length)
+    {
+        munmap((void*) m_data, m_length);
+        throw runtime_error(string("Unexpected end of event log: ") + filename);
+    }
+}
+
+EventLogReader::~EventLogReader()
+{
+    munmap((void*) m_data, m_length);
+}
+
+uint32_t EventLogReader::num_blocks() const
+{
+    return (m_num_records + EVENTLOG_BLOCK_RECORDS - 1) / EVENTLOG_BLOCK_RECORDS;
+}
+
+uint32_t EventLogReader::block_size(uint32_t b) const
+{
+    uint64_t first = (uint64_t) b * EVENTLOG_BLOCK_RECORDS;
+    uint64_t left  = m_num_records - first;
+    return (left < EVENTLOG_BLOCK_RECORDS) ? left : EVENTLOG_BLOCK_RECORDS;
+}
+
+const char* EventLogReader::block(uint32_t b) const
+{
+    return m_data + EVENTLOG_HEADER_SIZE + (size_t) b * EVENTLOG_BLOCK_SIZE;
+}
+
+const uint64_t* EventLogReader::time(uint32_t b) const    { return (const uint64_t*) (block(b) + COL_TIME); }
+const uint32_t* EventLogReader::addr(uint32_t b) const    { return (const uint32_t*) (block(b) + COL_ADDR); }
+const uint32_t* EventLogReader::latency(uint32_t b) const { return (const uint32_t*) (block(b) + COL_LATENCY); }
+const uint16_t* EventLogReader::set(uint32_t b) const     { return (const uint16_t*) (block(b) + COL_SET); }
+const uint16_t* EventLogReader::cpu(uint32_t b) const     { return (const uint16_t*) (block(b) + COL_CPU); }
+const int8_t*   EventLogReader::way(uint32_t b) const     { return (const int8_t*)   (block(b) + COL_WAY); }
+const uint8_t*  EventLogReader::flags(uint32_t b) const   { return (const uint8_t*)  (block(b) + COL_FLAGS); }
+
+void EventLogReader::get(uint64_t i, EventRecord& r) const
+{
+    uint32_t b = i / EVENTLOG_BLOCK_RECORDS;
+    uint32_t j = i % EVENTLOG_BLOCK_RECORDS;
+    r.time    = time(b)[j];
+    r.addr    = addr(b)[j];
+    r.latency = latency(b)[j];
+    r.set     = set(b)[j];
+    r.cpu     = cpu(b)[j];
+    r.way     = way(b)[j];
+    r.flags   = flags(b)[j];
+}
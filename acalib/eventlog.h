@@ -0,0 +1,154 @@
+/*
+// File: eventlog.h
+//
+// Header file for the binary per-access event log.
+// Every cache access can be appended as a fixed-width record to a
+// memory-mapped file, for offline analysis without text parsing.
+//
+// The file starts with a page-sized header followed by blocks of
+// EVENTLOG_BLOCK_RECORDS records. Within a block the records are stored
+// column by column, each column being a plain little-endian array:
+//
+//   uint64_t time[N]      cycle at which the access was issued
+//   uint32_t addr[N]      accessed address
+//   uint32_t latency[N]   cycles until the access completed
+//   uint16_t set[N]       cache set index
+//   uint16_t cpu[N]       CPU that issued the access
+//   int8_t   way[N]       position of the line in the set, -1 if unknown
+//   uint8_t  flags[N]     EVENT_HIT | EVENT_WRITE
+//
+// The last block is only filled up to the record count in the header.
+*/
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Number of records per block, keeps every block page-aligned
+static const uint32_t EVENTLOG_BLOCK_RECORDS = 65536;
+
+// Bits of EventRecord::flags
+enum EventFlags
+{
+    EVENT_HIT   = 0x1,
+    EVENT_WRITE = 0x2
+};
+
+// One access, as appended and read back
+struct EventRecord
+{
+    uint64_t time;
+    uint32_t addr;
+    uint32_t latency;
+    uint16_t set;
+    uint16_t cpu;
+    int8_t   way;
+    uint8_t  flags;
+};
+
+// On-disk file header
+struct EventLogHeader
+{
+    char     signature[4];      // "EVLG"
+    uint32_t version;
+    uint32_t block_records;
+    uint32_t record_size;       // sum of the column widths
+    uint64_t num_records;
+};
+
+class EventLogWriter
+{
+public:
+    // Creates or truncates the file, throws runtime_error on failure
+    EventLogWriter(const char* filename);
+
+    // Removes the file unless it was closed
+    ~EventLogWriter();
+
+    // Appends one record
+    void append(const EventRecord& r)
+    {
+        if (m_index == EVENTLOG_BLOCK_RECORDS)
+        {
+            next_block();
+        }
+        uint32_t i = m_index++;
+        m_time[i]    = r.time;
+        m_addr[i]    = r.addr;
+        m_latency[i] = r.latency;
+        m_set[i]     = r.set;
+        m_cpu[i]     = r.cpu;
+        m_way[i]     = r.way;
+        m_flags[i]   = r.flags;
+    }
+
+    // Writes the header and unmaps the file
+    void close();
+
+    // Number of records appended so far
+    uint64_t size() const;
+
+private:
+    std::string m_filename;
+    int       m_fd;
+    uint64_t  m_num_blocks;     // blocks in the file, the last one is mapped
+    uint32_t  m_index;          // next record in the mapped block
+    char*     m_block;
+
+    uint64_t* m_time;
+    uint32_t* m_addr;
+    uint32_t* m_latency;
+    uint16_t* m_set;
+    uint16_t* m_cpu;
+    int8_t*   m_way;
+    uint8_t*  m_flags;
+
+    void next_block();
+    void unmap_block();
+
+    // Closes and removes an incomplete file
+    void discard();
+
+    // Private copy constructor because no copies are allowed.
+    EventLogWriter(const EventLogWriter&);
+};
+
+class EventLogReader
+{
+public:
+    // Maps the whole file read-only, throws runtime_error on failure
+    EventLogReader(const char* filename);
+    ~EventLogReader();
+
+    // Number of records in the file
+    uint64_t size() const { return m_num_records; }
+
+    // Reads record i
+    void get(uint64_t i, EventRecord& r) const;
+
+    // Direct column access for block b, valid for block_size(b) records
+    uint32_t        num_blocks() const;
+    uint32_t        block_size(uint32_t b) const;
+    const uint64_t* time(uint32_t b) const;
+    const uint32_t* addr(uint32_t b) const;
+    const uint32_t* latency(uint32_t b) const;
+    const uint16_t* set(uint32_t b) const;
+    const uint16_t* cpu(uint32_t b) const;
+    const int8_t*   way(uint32_t b) const;
+    const uint8_t*  flags(uint32_t b) const;
+
+private:
+    const char* m_data;
+    size_t      m_length;
+    uint64_t    m_num_records;
+
+    const char* block(uint32_t b) const;
+
+    // Private copy constructor because no copies are allowed.
+    EventLogReader(const EventLogReader&);
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+// File: functional.cpp
+//
+// Source file for the functional simulation loop, see functional.h.
+*/
+
+#include <stdio.h>
+#include "functional.h"
+
+using namespace std;
+
+void run_functional(const MappedTraceFile& trace, vector<CacheCore>& caches,
+                    vector<AccessCounters>& stats, vector<MissClassifier>* classes)
+{
+    uint32_t         procs = trace.get_proc_count();
+    uint64_t         words = trace.num_words();
+    vector<char>     done(procs, 0);
+    TraceFile::Entry e;
+
+    uint32_t pid = 0;
+    for (uint64_t w = 0; w < words; w++)
+    {
+        if (!done[pid])
+        {
+            trace.decode(w, e);
+            switch (e.type)
+            {
+            case TraceFile::ENTRY_TYPE_READ:
+            case TraceFile::ENTRY_TYPE_WRITE:
+            {
+                bool hit = caches[pid].access(e.addr);
+                if (e.type == TraceFile::ENTRY_TYPE_READ)
+                    (hit ? stats[pid].readhit : stats[pid].readmiss)++;
+                else
+                    (hit ? stats[pid].writehit : stats[pid].writemiss)++;
+                if (classes != NULL)
+                    (*classes)[pid].access(e.addr, hit);
+                break;
+            }
+
+            case TraceFile::ENTRY_TYPE_END:
+                done[pid] = 1;
+                break;
+
+            default:
+                break;
+            }
+        }
+        if (++pid == procs)
+        {
+            pid = 0;
+        }
+    }
+}
+
+void print_counters(const vector<AccessCounters>& stats)
+{
+    printf("CPU\tReads\tRHit\tRMiss\tWrites\tWHit\tWMiss\tHitrate\n");
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const AccessCounters& s = stats[i];
+        uint64_t writes = s.writehit + s.writemiss;
+        uint64_t reads  = s.readhit + s.readmiss;
+
+        // Ratio of hits to the number of total accesses, as a percentage
+        double hitrate = (s.writehit + s.readhit) / (double) (writes + reads) * 100;
+
+        printf("%u\t%llu\t%llu\t%llu\t%llu\t%llu\t%llu\t%f\n", (unsigned) i,
+               (unsigned long long) reads, (unsigned long long) s.readhit, (unsigned long long) s.readmiss,
+               (unsigned long long) writes, (unsigned long long) s.writehit, (unsigned long long) s.writemiss,
+               hitrate);
+    }
+}
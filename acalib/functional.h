@@ -0,0 +1,38 @@
+/*
+// File: functional.h
+//
+// Header file for the functional (untimed) simulation loop shared by the
+// tools that only need hit and miss counts: every processor of a mapped
+// tracefile drives its own CacheCore, entries are taken in file order.
+*/
+
+#ifndef FUNCTIONAL_H
+#define FUNCTIONAL_H
+
+#include <vector>
+#include "cachecore.h"
+#include "missclass.h"
+#include "tracemap.h"
+
+// Per-CPU counters, as kept by aca2009.cpp
+struct AccessCounters
+{
+    uint64_t writehit;
+    uint64_t writemiss;
+    uint64_t readhit;
+    uint64_t readmiss;
+};
+
+/*
+ * Streams the whole trace through caches[pid] for every processor and adds
+ * the outcomes to stats[pid]. Both vectors need one entry per processor, as
+ * does classes when misses are to be classified.
+ */
+void run_functional(const MappedTraceFile& trace, std::vector<CacheCore>& caches,
+                    std::vector<AccessCounters>& stats,
+                    std::vector<MissClassifier>* classes = 0);
+
+// Pretty-prints the counters in the format of stats_print()
+void print_counters(const std::vector<AccessCounters>& stats);
+
+#endif
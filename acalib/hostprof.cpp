@@ -0,0 +1,148 @@
+/*
+// File: hostprof.cpp
+//
+// Source file for host-side profiling, see hostprof.h. Compiles to nothing
+// unless HOST_PROFILE is defined.
+*/
+
+#ifdef HOST_PROFILE
+
+#include <deque>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "hostprof.h"
+
+using namespace std;
+
+int hostprof_current = -1;
+
+// Deque, so that references stay valid while regions are added
+static deque<HostRegion> regions;
+
+// Host cycles between hostprof_start() and hostprof_stop()
+static uint64_t run_start, run_cycles;
+
+// Hardware and software counters of the whole process
+struct HostCounter
+{
+    const char* name;
+    uint32_t    type;
+    uint64_t    config;
+    int         fd;
+    uint64_t    value;
+};
+
+static HostCounter counters[] =
+{
+    { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,       -1, 0 },
+    { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,         -1, 0 },
+    { "cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,   -1, 0 },
+    { "cache-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,       -1, 0 },
+    { "branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,      -1, 0 },
+    { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,   -1, 0 },
+    { "page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,        -1, 0 },
+};
+
+static const int NUM_COUNTERS = sizeof(counters) / sizeof(counters[0]);
+
+int hostprof_region(const char* name)
+{
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        if (strcmp(regions[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    HostRegion r = { name, 0, 0, 0 };
+    regions.push_back(r);
+    return regions.size() - 1;
+}
+
+HostRegion& hostprof_get(int id)
+{
+    return regions[id];
+}
+
+static int open_counter(const HostCounter& c)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = c.type;
+    attr.config         = c.config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void hostprof_start()
+{
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        // Unavailable counters, e.g. with a restrictive perf_event_paranoid
+        // or in a VM, are left out of the report
+        counters[i].fd = open_counter(counters[i]);
+        if (counters[i].fd >= 0)
+        {
+            ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    run_start = hostprof_now();
+}
+
+void hostprof_stop()
+{
+    run_cycles = hostprof_now() - run_start;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (counters[i].fd >= 0)
+        {
+            ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counters[i].fd, &counters[i].value, sizeof(uint64_t)) != sizeof(uint64_t))
+            {
+                counters[i].value = 0;
+            }
+            close(counters[i].fd);
+        }
+    }
+}
+
+void hostprof_print()
+{
+    printf("Host profile: %llu host cycles\n", (unsigned long long) run_cycles);
+    printf("Region\tCalls\tCycles\tSelf\tSelf%%\tCycles/call\n");
+
+    uint64_t top = 0;
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        const HostRegion& r    = regions[i];
+        uint64_t          self = r.cycles - r.children;
+        top += self;
+        printf("%s\t%llu\t%llu\t%llu\t%.1f\t%.1f\n", r.name, (unsigned long long) r.calls,
+               (unsigned long long) r.cycles, (unsigned long long) self,
+               run_cycles == 0 ? 0 : 100.0 * self / run_cycles,
+               r.calls == 0 ? 0 : (double) r.cycles / r.calls);
+    }
+    uint64_t other = run_cycles > top ? run_cycles - top : 0;
+    printf("other\t-\t%llu\t%llu\t%.1f\t-\n", (unsigned long long) other, (unsigned long long) other,
+           run_cycles == 0 ? 0 : 100.0 * other / run_cycles);
+
+    printf("\nCounter\tValue\n");
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (counters[i].fd >= 0)
+            printf("%s\t%llu\n", counters[i].name, (unsigned long long) counters[i].value);
+        else
+            printf("%s\tunavailable\n", counters[i].name);
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+// File: hostprof.h
+//
+// Header file for host-side profiling of the simulators. Code regions are
+// timed with scoped timers reading the host's cycle counter, and the whole
+// run is measured with Linux perf_event counters (instructions, cycles,
+// cache misses, context switches). Everything is compiled out unless
+// HOST_PROFILE is defined: the macros expand to nothing and hostprof.cpp
+// is empty.
+//
+// Usage:
+//   void Cache::snoop() {
+//       HOST_PROFILE_SCOPE("cache.snoop");
+//       ...
+//   }
+//
+//   HOST_PROFILE_START();
+//   sc_start();
+//   HOST_PROFILE_STOP();
+//   HOST_PROFILE_PRINT();
+//
+// Scopes nest: each region reports its inclusive cycles and its self
+// cycles, without the regions entered from it. A scope must not span a
+// wait() of an SC_THREAD, or it would include the other processes run in
+// between; time outside all scopes is reported as "other" and is mostly
+// spent in the SystemC kernel.
+//
+// The profile is not thread-safe; use it from the simulation thread only.
+*/
+
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#ifdef HOST_PROFILE
+
+#include <stdint.h>
+#include <time.h>
+
+// Host cycle counter
+static inline uint64_t hostprof_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Per-region accumulators
+struct HostRegion
+{
+    const char* name;
+    uint64_t    calls;
+    uint64_t    cycles;     // inclusive
+    uint64_t    children;   // spent in nested regions
+};
+
+// Returns the id of the region of that name, registering it on first use
+int hostprof_region(const char* name);
+
+HostRegion& hostprof_get(int id);
+
+// Innermost active region, -1 outside all of them
+extern int hostprof_current;
+
+class HostProfileScope
+{
+public:
+    explicit HostProfileScope(int id) : m_id(id), m_parent(hostprof_current), m_start(hostprof_now())
+    {
+        hostprof_current = id;
+    }
+
+    ~HostProfileScope()
+    {
+        uint64_t    elapsed = hostprof_now() - m_start;
+        HostRegion& r       = hostprof_get(m_id);
+        r.calls++;
+        r.cycles += elapsed;
+        if (m_parent >= 0)
+        {
+            hostprof_get(m_parent).children += elapsed;
+        }
+        hostprof_current = m_parent;
+    }
+
+private:
+    int      m_id;
+    int      m_parent;
+    uint64_t m_start;
+};
+
+// Opens and starts the perf_event counters and the host cycle count
+void hostprof_start();
+
+// Stops them
+void hostprof_stop();
+
+// Prints the regions and the counters of the measured part of the run
+void hostprof_print();
+
+#define HOST_PROFILE_CAT2(a, b) a##b
+#define HOST_PROFILE_CAT(a, b)  HOST_PROFILE_CAT2(a, b)
+
+#define HOST_PROFILE_SCOPE(name) \
+    static const int HOST_PROFILE_CAT(hostprof_id_, __LINE__) = hostprof_region(name); \
+    HostProfileScope HOST_PROFILE_CAT(hostprof_scope_, __LINE__)(HOST_PROFILE_CAT(hostprof_id_, __LINE__))
+
+#define HOST_PROFILE_START() hostprof_start()
+#define HOST_PROFILE_STOP()  hostprof_stop()
+#define HOST_PROFILE_PRINT() hostprof_print()
+
+#else
+
+#define HOST_PROFILE_SCOPE(name)
+#define HOST_PROFILE_START() do { } while (0)
+#define HOST_PROFILE_STOP()  do { } while (0)
+#define HOST_PROFILE_PRINT() do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+/*
+// File: hosttime.h
+//
+// Header file for the host wall clock the tools time their runs with.
+// Header-only, so tools that do not link the rest of acalib can use it.
+*/
+
+#ifndef HOSTTIME_H
+#define HOSTTIME_H
+
+#include <time.h>
+
+// Monotonic wall clock time of the host in seconds
+static inline double host_seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
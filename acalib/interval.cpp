@@ -0,0 +1,149 @@
+/*
+// File: interval.cpp
+//
+// Source file for periodic interval statistics, see interval.h.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include "interval.h"
+
+using namespace std;
+
+WorkingSetSignature::WorkingSetSignature(uint32_t size)
+{
+    size_t words = 1;
+    while (words * 64 < size)
+    {
+        words *= 2;
+    }
+    bits.assign(words, 0);
+}
+
+void WorkingSetSignature::clear()
+{
+    fill(bits.begin(), bits.end(), 0);
+}
+
+bool WorkingSetSignature::empty() const
+{
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        if (bits[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double WorkingSetSignature::distance(const WorkingSetSignature& other) const
+{
+    int diff = 0, both = 0;
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        diff += __builtin_popcountll(bits[i] ^ other.bits[i]);
+        both += __builtin_popcountll(bits[i] | other.bits[i]);
+    }
+    return both == 0 ? 0 : (double) diff / both;
+}
+
+IntervalSampler::IntervalSampler(const char* filename, const StatRegistry& stats, uint64_t accesses,
+                                 uint32_t line_size, double threshold, uint32_t signature_bits)
+    : m_filename(filename), m_stats(stats), m_every(accesses), m_threshold(threshold),
+      m_intervals(0), m_accesses(0), m_signature(signature_bits), m_cycle(0), m_hits(0),
+      m_misses(0), m_transactions(0), m_latency_sum(0), m_latency_count(0), m_phase(-1)
+{
+    m_file = fopen(filename, "w");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to create file: ") + filename);
+    }
+    fprintf(m_file, "interval,cycle,accesses,hitrate,bus_util,amat,distance,phase,change\n");
+    fflush(m_file);
+
+    m_line_bits = 0;
+    while ((1u << m_line_bits) < line_size)
+    {
+        m_line_bits++;
+    }
+    m_signature.clear();
+}
+
+IntervalSampler::~IntervalSampler()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+    }
+}
+
+bool IntervalSampler::classify()
+{
+    if (m_phase >= 0 && m_signature.distance(m_phases[m_phase]) <= m_threshold)
+    {
+        // Follow the working set as it drifts within the phase
+        m_phases[m_phase] = m_signature;
+        return false;
+    }
+
+    for (size_t i = 0; i < m_phases.size(); i++)
+    {
+        if (m_signature.distance(m_phases[i]) <= m_threshold)
+        {
+            m_phase = i;
+            m_phases[i] = m_signature;
+            return true;
+        }
+    }
+    m_phase = m_phases.size();
+    m_phases.push_back(m_signature);
+    return true;
+}
+
+void IntervalSampler::interval(uint64_t cycle)
+{
+    uint64_t hits         = m_stats.sum("readhit") + m_stats.sum("writehit");
+    uint64_t misses       = m_stats.sum("readmiss") + m_stats.sum("writemiss");
+    uint64_t transactions = m_stats.sum("reads") + m_stats.sum("writes");
+    StatHistogram latency = m_stats.total("latency");
+
+    uint64_t cycles   = cycle - m_cycle;
+    uint64_t accesses = (hits - m_hits) + (misses - m_misses);
+    uint64_t samples  = latency.count - m_latency_count;
+
+    double distance = (m_phase >= 0) ? m_signature.distance(m_phases[m_phase]) : 1;
+    bool   change   = classify();
+
+    fprintf(m_file, "%llu,%llu,%llu,%f,%f,%f,%f,%d,%d\n",
+            (unsigned long long) m_intervals, (unsigned long long) cycle, (unsigned long long) accesses,
+            accesses == 0 ? 0 : 100.0 * (hits - m_hits) / accesses,
+            cycles == 0 ? 0 : (double) (transactions - m_transactions) / cycles,
+            samples == 0 ? 0 : (double) (latency.sum - m_latency_sum) / samples,
+            distance, m_phase, change ? 1 : 0);
+    fflush(m_file);
+
+    m_intervals++;
+    m_accesses      = 0;
+    m_cycle         = cycle;
+    m_hits          = hits;
+    m_misses        = misses;
+    m_transactions  = transactions;
+    m_latency_sum   = latency.sum;
+    m_latency_count = latency.count;
+    m_signature.clear();
+}
+
+void IntervalSampler::close(uint64_t cycle)
+{
+    if (m_accesses > 0 || cycle > m_cycle)
+    {
+        interval(cycle);
+    }
+    if (fclose(m_file) != 0)
+    {
+        m_file = NULL;
+        throw runtime_error("Unable to write file: " + m_filename);
+    }
+    m_file = NULL;
+}
@@ -0,0 +1,118 @@
+/*
+// File: interval.h
+//
+// Header file for periodic interval statistics with phase detection.
+// Every interval, of a fixed number of cycles or of accesses, appends one
+// line to a CSV file and flushes it, so long runs can be followed while
+// they execute:
+//
+//   interval,cycle,accesses,hitrate,bus_util,amat,distance,phase,change
+//
+// The hit rate, bus utilisation (bus transactions per cycle) and average
+// memory access time are the deltas of the statistics registry over the
+// interval. Phases are detected from working-set signatures: every access
+// sets a hashed bit of its line in a bit vector. The vector needs several
+// bits per line an interval touches, or it fills up and every interval
+// looks alike; the simulator sizes it from the lines its caches hold. The
+// relative distance between the signatures of two intervals is
+//
+//   |A xor B| / |A or B|
+//
+// An interval further than the threshold from the current phase starts a
+// new phase. It gets the id of an earlier phase whose signature is within
+// the threshold, so a recurring phase is recognised, or a new id
+// otherwise. Such intervals are marked with change=1.
+*/
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "statistics.h"
+
+// Bit vector of the lines touched in an interval
+struct WorkingSetSignature
+{
+    std::vector<uint64_t> bits;     // a power of two words
+
+    // Rounds size up to a power of two bits, at least 64
+    explicit WorkingSetSignature(uint32_t size = 1024);
+
+    void clear();
+
+    void add(uint32_t line)
+    {
+        uint32_t h = line * 0x9E3779B1u;
+        h ^= h >> 15;
+        bits[(h >> 6) & (bits.size() - 1)] |= 1ULL << (h & 63);
+    }
+
+    bool empty() const;
+
+    // Relative distance to another signature, 0 if both are empty
+    double distance(const WorkingSetSignature& other) const;
+};
+
+class IntervalSampler
+{
+public:
+    /*
+     * Writes intervals of the given statistics to filename. With accesses
+     * > 0 an interval ends every that many accesses, otherwise only when
+     * interval() is called. line_size gives the granularity of the
+     * signatures, signature_bits their size.
+     */
+    IntervalSampler(const char* filename, const StatRegistry& stats, uint64_t accesses,
+                    uint32_t line_size, double threshold = 0.5, uint32_t signature_bits = 1024);
+    ~IntervalSampler();
+
+    // Counts an access, at the given cycle
+    void access(uint32_t addr, uint64_t cycle)
+    {
+        m_signature.add(addr >> m_line_bits);
+        if (++m_accesses == m_every)
+        {
+            interval(cycle);
+        }
+    }
+
+    // Ends the current interval at the given cycle
+    void interval(uint64_t cycle);
+
+    // Ends the last interval and closes the file
+    void close(uint64_t cycle);
+
+    uint64_t intervals() const { return m_intervals; }
+    uint32_t phases() const    { return m_phases.size(); }
+
+private:
+    FILE*               m_file;
+    std::string         m_filename;
+    const StatRegistry& m_stats;
+    uint64_t            m_every;
+    uint32_t            m_line_bits;
+    double              m_threshold;
+
+    uint64_t            m_intervals;
+    uint64_t            m_accesses;     // in the current interval
+    WorkingSetSignature m_signature;    // of the current interval
+
+    // Registry totals at the start of the current interval
+    uint64_t            m_cycle;
+    uint64_t            m_hits;
+    uint64_t            m_misses;
+    uint64_t            m_transactions;
+    uint64_t            m_latency_sum;
+    uint64_t            m_latency_count;
+
+    std::vector<WorkingSetSignature> m_phases;  // signature per phase id
+    int                              m_phase;   // current phase, -1 before the first
+
+    // Classifies the current signature, returns true on a phase change
+    bool classify();
+};
+
+#endif
@@ -0,0 +1,147 @@
+/*
+// File: log.cpp
+//
+// Source file for the logging facility of the simulators. Records are
+// formatted straight into a fixed buffer by a streambuf, which is written
+// to the log file with a single fwrite() whenever it fills up.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <streambuf>
+#include "log.h"
+
+using namespace std;
+
+// Size of the record buffer in bytes
+static const size_t LOG_BUFFER_SIZE = 1 << 20;
+
+class LogBuffer : public streambuf
+{
+public:
+    LogBuffer() : m_file(NULL)
+    {
+        setp(m_buffer, m_buffer + LOG_BUFFER_SIZE);
+    }
+
+    // Writes out the buffered characters
+    void flush()
+    {
+        size_t size = pptr() - pbase();
+        if (size > 0)
+        {
+            fwrite(pbase(), 1, size, m_file != NULL ? m_file : stderr);
+            setp(m_buffer, m_buffer + LOG_BUFFER_SIZE);
+        }
+        fflush(m_file != NULL ? m_file : stderr);
+    }
+
+    void open(const char* filename)
+    {
+        close();
+        m_file = fopen(filename, "w");
+        if (m_file != NULL)
+        {
+            // We do our own buffering
+            setvbuf(m_file, NULL, _IONBF, 0);
+        }
+    }
+
+    void close()
+    {
+        flush();
+        if (m_file != NULL)
+        {
+            fclose(m_file);
+            m_file = NULL;
+        }
+    }
+
+protected:
+    virtual int overflow(int c)
+    {
+        flush();
+        if (c != EOF)
+        {
+            *pptr() = (char) c;
+            pbump(1);
+        }
+        return c;
+    }
+
+    virtual int sync()
+    {
+        flush();
+        return 0;
+    }
+
+private:
+    FILE* m_file;
+    char  m_buffer[LOG_BUFFER_SIZE];
+};
+
+static const char* const level_names[] =
+{
+    "", "[ERROR] ", "[WARN] ", "[INFO] ", "[DEBUG] ", "[TRACE] "
+};
+
+// Allocated on first use so records can be written from static constructors
+static LogBuffer* log_buffer = NULL;
+static ostream*   log_stream = NULL;
+
+static void log_at_exit()
+{
+    log_close();
+}
+
+static ostream& log_get_stream()
+{
+    if (log_stream == NULL)
+    {
+        log_buffer = new LogBuffer();
+        log_stream = new ostream(log_buffer);
+        atexit(log_at_exit);
+    }
+    return *log_stream;
+}
+
+void log_open(const char* filename)
+{
+    log_get_stream();
+    log_buffer->open(filename);
+}
+
+void log_close()
+{
+    if (log_buffer != NULL)
+    {
+        log_buffer->close();
+    }
+}
+
+void log_flush()
+{
+    if (log_buffer != NULL)
+    {
+        log_buffer->flush();
+    }
+}
+
+ostream& log_begin(int level)
+{
+    ostream& os = log_get_stream();
+    if (level > LOG_LEVEL_NONE && level <= LOG_LEVEL_TRACE)
+    {
+        os << level_names[level];
+    }
+    return os;
+}
+
+void log_end(int level)
+{
+    log_stream->put('\n');
+    if (level <= LOG_LEVEL_ERROR)
+    {
+        log_buffer->flush();
+    }
+}
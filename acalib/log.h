@@ -0,0 +1,93 @@
+/*
+// File: log.h
+//
+// Header file for the logging facility of the simulators.
+// Log records have a severity level, and levels above LOG_LEVEL are
+// removed at compile time: their macros expand to nothing, so neither the
+// message nor its arguments generate any code. Enabled records are only
+// formatted when they are emitted, directly into a large buffer that is
+// written out when it fills up, when an error is logged, and at exit.
+//
+// Usage:
+//   log_open("logger.log");
+//   LOG_DEBUG("[Cache" << pid << "] started");
+//
+// LOG_LEVEL defaults to LOG_LEVEL_WARN when NDEBUG is defined (release
+// builds) and to LOG_LEVEL_TRACE otherwise. Override it with e.g.
+// -DLOG_LEVEL=LOG_LEVEL_INFO.
+//
+// The sink is not thread-safe; log from the simulation thread only.
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <ostream>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_WARN
+#else
+#define LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+/*
+ * Directs the log to the given file, truncating it. Until this is called,
+ * or when the file cannot be opened, records go to stderr.
+ */
+void log_open(const char* filename);
+
+// Flushes and closes the log file
+void log_close();
+
+// Writes out all buffered records
+void log_flush();
+
+// Starts a record of the given level and returns the stream to format it in
+std::ostream& log_begin(int level);
+
+// Terminates the record started by log_begin()
+void log_end(int level);
+
+#define LOG_RECORD(level, msg) \
+    do { log_begin(level) << msg; log_end(level); } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(msg) LOG_RECORD(LOG_LEVEL_ERROR, msg)
+#else
+#define LOG_ERROR(msg) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(msg) LOG_RECORD(LOG_LEVEL_WARN, msg)
+#else
+#define LOG_WARN(msg) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(msg) LOG_RECORD(LOG_LEVEL_INFO, msg)
+#else
+#define LOG_INFO(msg) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(msg) LOG_RECORD(LOG_LEVEL_DEBUG, msg)
+#else
+#define LOG_DEBUG(msg) do { } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(msg) LOG_RECORD(LOG_LEVEL_TRACE, msg)
+#else
+#define LOG_TRACE(msg) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,292 @@
+/*
+// File: missclass.cpp
+//
+// Source file for the online miss classifier, see missclass.h.
+*/
+
+#include <stdio.h>
+#include "missclass.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+// Marks an empty slot; line numbers are addresses shifted right, so they
+// never reach it
+static const uint32_t EMPTY   = 0xFFFFFFFF;
+static const uint32_t DELETED = 0xFFFFFFFE;
+
+static inline size_t hash_line(uint32_t line)
+{
+    return (line * 0x9E3779B1u) ^ (line >> 16);
+}
+
+const char* miss_class_name(MissClass c)
+{
+    static const char* const names[] =
+    {
+        "hit", "compulsory", "capacity", "conflict", "coherence"
+    };
+    return names[c];
+}
+
+LineSet::LineSet() : m_slots(1024, EMPTY), m_size(0), m_used(0)
+{
+}
+
+size_t LineSet::find(uint32_t line) const
+{
+    size_t mask = m_slots.size() - 1;
+    size_t i    = hash_line(line) & mask;
+    size_t tomb = (size_t) -1;
+    while (m_slots[i] != EMPTY && m_slots[i] != line)
+    {
+        if (m_slots[i] == DELETED && tomb == (size_t) -1)
+        {
+            tomb = i;
+        }
+        i = (i + 1) & mask;
+    }
+    // Reuse the first deleted slot on the way when the line is absent
+    return (m_slots[i] == EMPTY && tomb != (size_t) -1) ? tomb : i;
+}
+
+void LineSet::rehash(size_t capacity)
+{
+    vector<uint32_t> old(capacity, EMPTY);
+    old.swap(m_slots);
+    m_size = 0;
+    m_used = 0;
+    for (size_t i = 0; i < old.size(); i++)
+    {
+        if (old[i] != EMPTY && old[i] != DELETED)
+        {
+            insert(old[i]);
+        }
+    }
+}
+
+bool LineSet::insert(uint32_t line)
+{
+    size_t i = find(line);
+    if (m_slots[i] == line)
+    {
+        return false;
+    }
+    if (m_slots[i] == EMPTY)
+    {
+        m_used++;
+    }
+    m_slots[i] = line;
+    m_size++;
+    if (m_used * 2 > m_slots.size())
+    {
+        rehash(m_size * 4 > m_slots.size() ? m_slots.size() * 2 : m_slots.size());
+    }
+    return true;
+}
+
+bool LineSet::erase(uint32_t line)
+{
+    size_t i = find(line);
+    if (m_slots[i] != line)
+    {
+        return false;
+    }
+    m_slots[i] = DELETED;
+    m_size--;
+    return true;
+}
+
+void LineSet::save(CheckpointWriter& out) const
+{
+    out.put((uint64_t) m_size);
+    out.put((uint64_t) m_used);
+    out.put_vector(m_slots);
+}
+
+void LineSet::load(CheckpointReader& in)
+{
+    m_size = in.get<uint64_t>();
+    m_used = in.get<uint64_t>();
+    in.get_vector(m_slots);
+    if (m_slots.empty() || (m_slots.size() & (m_slots.size() - 1)) != 0)
+    {
+        in.fail("bad line set");
+    }
+}
+
+ShadowCache::ShadowCache(uint32_t lines) : m_nodes(lines + 1), m_used(0)
+{
+    size_t size = 1;
+    while (size < 2 * (size_t) lines)
+    {
+        size *= 2;
+    }
+    m_table.assign(size, 0);
+    m_nodes[0].prev = m_nodes[0].next = 0;
+}
+
+// Slot of line in the table, or the empty slot where it would go
+size_t ShadowCache::slot(uint32_t line) const
+{
+    size_t mask = m_table.size() - 1;
+    size_t i    = hash_line(line) & mask;
+    while (m_table[i] != 0 && m_nodes[m_table[i]].line != line)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void ShadowCache::remove_from_table(uint32_t line)
+{
+    // Backward-shift deletion keeps the probe sequences intact
+    size_t mask = m_table.size() - 1;
+    size_t i    = slot(line);
+    m_table[i]  = 0;
+    for (size_t j = (i + 1) & mask; m_table[j] != 0; j = (j + 1) & mask)
+    {
+        size_t home = hash_line(m_nodes[m_table[j]].line) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            m_table[i] = m_table[j];
+            m_table[j] = 0;
+            i = j;
+        }
+    }
+}
+
+void ShadowCache::unlink(uint32_t n)
+{
+    m_nodes[m_nodes[n].prev].next = m_nodes[n].next;
+    m_nodes[m_nodes[n].next].prev = m_nodes[n].prev;
+}
+
+void ShadowCache::push_front(uint32_t n)
+{
+    m_nodes[n].prev = 0;
+    m_nodes[n].next = m_nodes[0].next;
+    m_nodes[m_nodes[0].next].prev = n;
+    m_nodes[0].next = n;
+}
+
+bool ShadowCache::access(uint32_t line)
+{
+    size_t i = slot(line);
+    if (m_table[i] != 0)
+    {
+        uint32_t n = m_table[i];
+        unlink(n);
+        push_front(n);
+        return true;
+    }
+
+    uint32_t n;
+    if (m_used + 1 < m_nodes.size())
+    {
+        n = ++m_used;
+    }
+    else
+    {
+        // Evict the least recently used line
+        n = m_nodes[0].prev;
+        unlink(n);
+        remove_from_table(m_nodes[n].line);
+        i = slot(line);
+    }
+    m_nodes[n].line = line;
+    m_table[i] = n;
+    push_front(n);
+    return false;
+}
+
+void ShadowCache::save(CheckpointWriter& out) const
+{
+    out.put(m_used);
+    out.put_vector(m_nodes);
+    out.put_vector(m_table);
+}
+
+void ShadowCache::load(CheckpointReader& in)
+{
+    in.get(m_used);
+    in.get_vector(m_nodes, m_nodes.size());
+    in.get_vector(m_table, m_table.size());
+}
+
+MissClassifier::MissClassifier(uint32_t lines, uint32_t line_size) : m_shadow(lines)
+{
+    m_line_bits = 0;
+    while ((1u << m_line_bits) < line_size)
+    {
+        m_line_bits++;
+    }
+    for (int c = 0; c < MISS_CLASSES; c++)
+    {
+        m_counts[c] = 0;
+    }
+}
+
+MissClass MissClassifier::access(uint32_t addr, bool hit)
+{
+    uint32_t  line   = addr >> m_line_bits;
+    bool      shadow = m_shadow.access(line);
+    MissClass c      = MISS_NONE;
+
+    if (m_touched.insert(line))
+    {
+        c = MISS_COMPULSORY;
+    }
+    else if (m_invalidated.size() > 0 && m_invalidated.erase(line))
+    {
+        c = hit ? MISS_NONE : MISS_COHERENCE;
+    }
+    else if (!hit)
+    {
+        c = shadow ? MISS_CONFLICT : MISS_CAPACITY;
+    }
+    m_counts[c]++;
+    return c;
+}
+
+void MissClassifier::save(CheckpointWriter& out) const
+{
+    out.section("MCLS");
+    out.put(m_line_bits);
+    m_touched.save(out);
+    m_invalidated.save(out);
+    m_shadow.save(out);
+    out.put(m_counts);
+}
+
+void MissClassifier::load(CheckpointReader& in)
+{
+    in.section("MCLS");
+    if (in.get<uint32_t>() != m_line_bits)
+    {
+        in.fail("different line size");
+    }
+    m_touched.load(in);
+    m_invalidated.load(in);
+    m_shadow.load(in);
+    in.get(m_counts);
+}
+
+void MissClassifier::invalidated(uint32_t addr)
+{
+    m_invalidated.insert(addr >> m_line_bits);
+}
+
+void print_miss_classes(const vector<const MissClassifier*>& classifiers)
+{
+    printf("CPU\tMisses\tCompulsory\tCapacity\tConflict\tCoherence\n");
+    for (size_t i = 0; i < classifiers.size(); i++)
+    {
+        const MissClassifier& m = *classifiers[i];
+        printf("%u\t%llu\t%llu\t%llu\t%llu\t%llu\n", (unsigned) i,
+               (unsigned long long) (m.count(MISS_COMPULSORY) + m.count(MISS_CAPACITY) +
+                                     m.count(MISS_CONFLICT) + m.count(MISS_COHERENCE)),
+               (unsigned long long) m.count(MISS_COMPULSORY), (unsigned long long) m.count(MISS_CAPACITY),
+               (unsigned long long) m.count(MISS_CONFLICT), (unsigned long long) m.count(MISS_COHERENCE));
+    }
+}
@@ -0,0 +1,127 @@
+/*
+// File: missclass.h
+//
+// Header file for the online miss classifier. Every access of a cache is
+// fed to the classifier, which sorts each miss into one of:
+//
+//   compulsory  first access to the line, found with a first-touch set
+//   coherence   the line was invalidated by another cache since its last use
+//   capacity    a fully associative LRU cache of the same size misses too
+//   conflict    the fully associative cache would have hit
+//
+// The shadow fully associative cache is a hash map into an intrusive LRU
+// list, so an access costs a few hash lookups and the classifier can stay
+// enabled. Capacity misses would only go away with a larger cache,
+// conflict misses with more ways.
+*/
+
+#ifndef MISSCLASS_H
+#define MISSCLASS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+enum MissClass
+{
+    MISS_NONE,          // the access hit
+    MISS_COMPULSORY,
+    MISS_CAPACITY,
+    MISS_CONFLICT,
+    MISS_COHERENCE,
+    MISS_CLASSES
+};
+
+const char* miss_class_name(MissClass c);
+
+// Open-addressing hash set of line numbers
+class LineSet
+{
+public:
+    LineSet();
+
+    // Inserts line, returns false if it was already present
+    bool insert(uint32_t line);
+
+    // Removes line, returns false if it was not present
+    bool erase(uint32_t line);
+
+    bool contains(uint32_t line) const { return m_slots[find(line)] == line; }
+
+    size_t size() const { return m_size; }
+
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    std::vector<uint32_t> m_slots;
+    size_t                m_size;
+    size_t                m_used;   // including deleted slots
+
+    size_t find(uint32_t line) const;
+    void   rehash(size_t capacity);
+};
+
+// Fully associative LRU cache of line numbers
+class ShadowCache
+{
+public:
+    explicit ShadowCache(uint32_t lines);
+
+    // Accesses line, returns true on a hit
+    bool access(uint32_t line);
+
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    struct Node
+    {
+        uint32_t line;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    std::vector<Node>     m_nodes;  // m_nodes[0] is the list head
+    std::vector<uint32_t> m_table;  // open-addressing line -> node index
+    uint32_t              m_used;
+
+    size_t slot(uint32_t line) const;
+    void   unlink(uint32_t n);
+    void   push_front(uint32_t n);
+    void   remove_from_table(uint32_t line);
+};
+
+class MissClassifier
+{
+public:
+    // Classifies the misses of a cache of the given number of lines
+    MissClassifier(uint32_t lines, uint32_t line_size);
+
+    // Feeds an access of the cache, returns the class of the miss
+    MissClass access(uint32_t addr, bool hit);
+
+    // Notes that the line holding addr was invalidated by another cache
+    void invalidated(uint32_t addr);
+
+    uint64_t count(MissClass c) const { return m_counts[c]; }
+
+    // Writes or restores the line sets, shadow cache and counters
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    uint32_t    m_line_bits;
+    LineSet     m_touched;
+    LineSet     m_invalidated;
+    ShadowCache m_shadow;
+    uint64_t    m_counts[MISS_CLASSES];
+};
+
+// Prints a per-CPU table of the miss classes, one classifier per CPU
+void print_miss_classes(const std::vector<const MissClassifier*>& classifiers);
+
+#endif
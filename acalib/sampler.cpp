@@ -0,0 +1,92 @@
+/*
+// File: sampler.cpp
+//
+// Source file for systematic sampling, see sampler.h.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdexcept>
+#include "sampler.h"
+
+using namespace std;
+
+// Two-sided 95% confidence
+static const double Z_95 = 1.96;
+
+// Target relative error used to suggest the number of windows
+static const double TARGET_ERROR = 0.03;
+
+Sampler::Sampler(uint32_t cpus, uint64_t period, uint64_t window, uint64_t warmup)
+    : m_period(period), m_window(window), m_warmup(warmup)
+{
+    if (window == 0 || window + warmup > period)
+    {
+        throw runtime_error("Sampling window and warm-up must fit in the period");
+    }
+    Cpu zero = { 0, 0, false, 0, 0, 0 };
+    m_cpus.assign(cpus, zero);
+}
+
+bool Sampler::step(uint32_t cpu, uint64_t cycle)
+{
+    Cpu&     c   = m_cpus[cpu];
+    uint64_t pos = c.entries++ % m_period;
+
+    if (c.measuring && pos == 0)
+    {
+        // The entries of the window have all completed
+        double cpe = (cycle - c.start) / (double) m_window;
+        c.n++;
+        c.sum   += cpe;
+        c.sumsq += cpe * cpe;
+        c.measuring = false;
+    }
+    if (pos == m_period - m_window)
+    {
+        c.start     = cycle;
+        c.measuring = true;
+    }
+    return pos >= m_period - m_window - m_warmup;
+}
+
+void Sampler::print() const
+{
+    printf("Sampling: period %llu, window %llu, warm-up %llu entries\n",
+           (unsigned long long) m_period, (unsigned long long) m_window, (unsigned long long) m_warmup);
+    printf("CPU\tEntries\tWindows\tCPE\t+-95%%\tCycles\t+-95%%\tNeeded\n");
+
+    double total = 0, total_ci = 0;
+    for (size_t i = 0; i < m_cpus.size(); i++)
+    {
+        const Cpu& c = m_cpus[i];
+        if (c.n == 0)
+        {
+            printf("%u\t%llu\t0\t-\t-\t-\t-\t-\n", (unsigned) i, (unsigned long long) c.entries);
+            continue;
+        }
+
+        double mean = c.sum / c.n;
+        double var  = c.n > 1 ? (c.sumsq - c.n * mean * mean) / (c.n - 1) : 0;
+        double sd   = var > 0 ? sqrt(var) : 0;
+        double ci   = Z_95 * sd / sqrt((double) c.n);
+
+        // Windows for the target error, from the coefficient of variation
+        double cv     = mean > 0 ? sd / mean : 0;
+        double needed = ceil(pow(Z_95 * cv / TARGET_ERROR, 2));
+
+        double cycles = mean * c.entries;
+        printf("%u\t%llu\t%llu\t%f\t%f\t%.0f\t%.0f\t%.0f\n", (unsigned) i,
+               (unsigned long long) c.entries, (unsigned long long) c.n, mean, ci,
+               cycles, ci * c.entries, needed);
+
+        // The run ends with the slowest CPU
+        if (cycles > total)
+        {
+            total    = cycles;
+            total_ci = ci * c.entries;
+        }
+    }
+    printf("Estimated cycles: %.0f +- %.0f (95%%)\n", total, total_ci);
+    printf("Needed: windows for a +-%.0f%% interval at 95%% confidence\n", TARGET_ERROR * 100);
+}
@@ -0,0 +1,61 @@
+/*
+// File: sampler.h
+//
+// Header file for systematic sampling of a timed simulation (SMARTS). The
+// trace of every CPU is split into periods of a fixed number of entries.
+// Each period ends with a detailed part: some warm-up entries, then the
+// measured window. The rest of the period is applied functionally to the
+// caches only. This keeps them warm at a fraction of the cost of timed
+// simulation.
+//
+// The detailed model reports the cycles of every measured window, and the
+// cycles per trace entry are estimated from these samples with a
+// confidence interval:
+//
+//   mean +- z * stddev / sqrt(n)
+//
+// The estimate is scaled by the number of entries to give the cycles of
+// the whole trace.
+*/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <vector>
+
+class Sampler
+{
+public:
+    // Periods of period entries, ending in warmup detailed and window
+    // measured entries
+    Sampler(uint32_t cpus, uint64_t period, uint64_t window, uint64_t warmup);
+
+    /*
+     * Counts the next trace entry of cpu, fetched at the given cycle.
+     * Returns true if the entry is to be simulated in detail, false if it
+     * is only applied functionally.
+     */
+    bool step(uint32_t cpu, uint64_t cycle);
+
+    // Prints per-CPU estimates of the cycles with 95% confidence intervals
+    void print() const;
+
+private:
+    struct Cpu
+    {
+        uint64_t entries;   // entries seen, detailed or not
+        uint64_t start;     // cycle at which the current window started
+        bool     measuring;
+        uint64_t n;         // completed windows
+        double   sum;       // of the cycles per entry of the windows
+        double   sumsq;
+    };
+
+    uint64_t         m_period;
+    uint64_t         m_window;
+    uint64_t         m_warmup;
+    std::vector<Cpu> m_cpus;
+};
+
+#endif
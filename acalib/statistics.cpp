@@ -0,0 +1,318 @@
+/*
+// File: statistics.cpp
+//
+// Source file for the statistics registry, see statistics.h.
+*/
+
+#include <string.h>
+#include "statistics.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+void StatHistogram::clear()
+{
+    memset(this, 0, sizeof(*this));
+    min = ~(uint64_t) 0;
+}
+
+StatCounter& StatGroup::counter(const string& name)
+{
+    for (size_t i = 0; i < m_counter_names.size(); i++)
+    {
+        if (m_counter_names[i] == name)
+        {
+            return m_counters[i];
+        }
+    }
+    StatCounter zero;
+    memset(&zero, 0, sizeof(zero));
+    m_counter_names.push_back(name);
+    m_counters.push_back(zero);
+    return m_counters.back();
+}
+
+StatHistogram& StatGroup::histogram(const string& name)
+{
+    for (size_t i = 0; i < m_histogram_names.size(); i++)
+    {
+        if (m_histogram_names[i] == name)
+        {
+            return m_histograms[i];
+        }
+    }
+    StatHistogram empty;
+    empty.clear();
+    m_histogram_names.push_back(name);
+    m_histograms.push_back(empty);
+    return m_histograms.back();
+}
+
+uint64_t StatGroup::value(const string& name) const
+{
+    for (size_t i = 0; i < m_counter_names.size(); i++)
+    {
+        if (m_counter_names[i] == name)
+        {
+            return m_counters[i].value;
+        }
+    }
+    return 0;
+}
+
+const StatHistogram* StatGroup::find_histogram(const string& name) const
+{
+    for (size_t i = 0; i < m_histogram_names.size(); i++)
+    {
+        if (m_histogram_names[i] == name)
+        {
+            return &m_histograms[i];
+        }
+    }
+    return NULL;
+}
+
+StatGroup& StatRegistry::group(const string& name)
+{
+    for (size_t i = 0; i < m_groups.size(); i++)
+    {
+        if (m_groups[i].name() == name)
+        {
+            return m_groups[i];
+        }
+    }
+    m_groups.push_back(StatGroup(name));
+    return m_groups.back();
+}
+
+void StatRegistry::flatten(vector<pair<const string*, string> >* names, vector<uint64_t>* values) const
+{
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const StatGroup& group = m_groups[g];
+        for (size_t i = 0; i < group.m_counters.size(); i++)
+        {
+            if (names != NULL)
+                names->push_back(make_pair(&group.m_name, group.m_counter_names[i]));
+            if (values != NULL)
+                values->push_back(group.m_counters[i].value);
+        }
+        for (size_t i = 0; i < group.m_histograms.size(); i++)
+        {
+            if (names != NULL)
+            {
+                names->push_back(make_pair(&group.m_name, group.m_histogram_names[i] + ".count"));
+                names->push_back(make_pair(&group.m_name, group.m_histogram_names[i] + ".sum"));
+            }
+            if (values != NULL)
+            {
+                values->push_back(group.m_histograms[i].count);
+                values->push_back(group.m_histograms[i].sum);
+            }
+        }
+    }
+}
+
+void StatRegistry::snapshot(uint64_t cycle)
+{
+    Snapshot s;
+    s.cycle = cycle;
+    flatten(NULL, &s.values);
+    m_snapshots.push_back(s);
+}
+
+uint64_t StatRegistry::sum(const string& counter) const
+{
+    uint64_t sum = 0;
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        sum += m_groups[g].value(counter);
+    }
+    return sum;
+}
+
+StatHistogram StatRegistry::total(const string& histogram) const
+{
+    StatHistogram sum;
+    sum.clear();
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const StatHistogram* h = m_groups[g].find_histogram(histogram);
+        if (h == NULL || h->count == 0)
+        {
+            continue;
+        }
+        sum.count += h->count;
+        sum.sum   += h->sum;
+        sum.min    = h->min < sum.min ? h->min : sum.min;
+        sum.max    = h->max > sum.max ? h->max : sum.max;
+        for (int b = 0; b < STAT_BUCKETS; b++)
+        {
+            sum.buckets[b] += h->buckets[b];
+        }
+    }
+    return sum;
+}
+
+// Exclusive upper bound of a histogram bucket, as printed
+static string bucket_name(int b)
+{
+    char name[32];
+    if (b == STAT_BUCKETS - 1)
+        snprintf(name, sizeof(name), "lt2^64");
+    else
+        snprintf(name, sizeof(name), "lt%llu", 1ULL << b);
+    return name;
+}
+
+static void write_json_histogram(FILE* f, const StatHistogram& h)
+{
+    fprintf(f, "{\"count\": %llu, \"sum\": %llu, \"min\": %llu, \"max\": %llu, \"mean\": %f, \"buckets\": {",
+            (unsigned long long) h.count, (unsigned long long) h.sum,
+            (unsigned long long) (h.count == 0 ? 0 : h.min), (unsigned long long) h.max, h.mean());
+    const char* sep = "";
+    for (int b = 0; b < STAT_BUCKETS; b++)
+    {
+        if (h.buckets[b] != 0)
+        {
+            fprintf(f, "%s\"%s\": %llu", sep, bucket_name(b).c_str(), (unsigned long long) h.buckets[b]);
+            sep = ", ";
+        }
+    }
+    fprintf(f, "}}");
+}
+
+void StatRegistry::write_json(FILE* f, uint64_t cycle) const
+{
+    fprintf(f, "{\n  \"cycle\": %llu,\n  \"groups\": {\n", (unsigned long long) cycle);
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const StatGroup& group = m_groups[g];
+        fprintf(f, "    \"%s\": {", group.m_name.c_str());
+        const char* sep = "";
+        for (size_t i = 0; i < group.m_counters.size(); i++)
+        {
+            fprintf(f, "%s\n      \"%s\": %llu", sep, group.m_counter_names[i].c_str(),
+                    (unsigned long long) group.m_counters[i].value);
+            sep = ",";
+        }
+        for (size_t i = 0; i < group.m_histograms.size(); i++)
+        {
+            fprintf(f, "%s\n      \"%s\": ", sep, group.m_histogram_names[i].c_str());
+            write_json_histogram(f, group.m_histograms[i]);
+            sep = ",";
+        }
+        fprintf(f, "\n    }%s\n", (g + 1 < m_groups.size()) ? "," : "");
+    }
+    fprintf(f, "  },\n  \"snapshots\": [\n");
+
+    vector<pair<const string*, string> > names;
+    flatten(&names, NULL);
+    for (size_t s = 0; s < m_snapshots.size(); s++)
+    {
+        const Snapshot& snap = m_snapshots[s];
+        fprintf(f, "    {\"cycle\": %llu", (unsigned long long) snap.cycle);
+        for (size_t i = 0; i < snap.values.size() && i < names.size(); i++)
+        {
+            fprintf(f, ", \"%s.%s\": %llu", names[i].first->c_str(), names[i].second.c_str(),
+                    (unsigned long long) snap.values[i]);
+        }
+        fprintf(f, "}%s\n", (s + 1 < m_snapshots.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+void StatRegistry::write_csv(FILE* f, uint64_t cycle) const
+{
+    vector<pair<const string*, string> > names;
+    flatten(&names, NULL);
+
+    fprintf(f, "cycle,group,name,value\n");
+    for (size_t s = 0; s < m_snapshots.size(); s++)
+    {
+        const Snapshot& snap = m_snapshots[s];
+        for (size_t i = 0; i < snap.values.size() && i < names.size(); i++)
+        {
+            fprintf(f, "%llu,%s,%s,%llu\n", (unsigned long long) snap.cycle, names[i].first->c_str(),
+                    names[i].second.c_str(), (unsigned long long) snap.values[i]);
+        }
+    }
+
+    // Final values, with the histogram buckets
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const StatGroup& group = m_groups[g];
+        const char*      gname = group.m_name.c_str();
+        for (size_t i = 0; i < group.m_counters.size(); i++)
+        {
+            fprintf(f, "%llu,%s,%s,%llu\n", (unsigned long long) cycle, gname,
+                    group.m_counter_names[i].c_str(), (unsigned long long) group.m_counters[i].value);
+        }
+        for (size_t i = 0; i < group.m_histograms.size(); i++)
+        {
+            const StatHistogram& h    = group.m_histograms[i];
+            const char*          name = group.m_histogram_names[i].c_str();
+            fprintf(f, "%llu,%s,%s.count,%llu\n", (unsigned long long) cycle, gname, name,
+                    (unsigned long long) h.count);
+            fprintf(f, "%llu,%s,%s.sum,%llu\n", (unsigned long long) cycle, gname, name,
+                    (unsigned long long) h.sum);
+            for (int b = 0; b < STAT_BUCKETS; b++)
+            {
+                if (h.buckets[b] != 0)
+                {
+                    fprintf(f, "%llu,%s,%s.%s,%llu\n", (unsigned long long) cycle, gname, name,
+                            bucket_name(b).c_str(), (unsigned long long) h.buckets[b]);
+                }
+            }
+        }
+    }
+}
+
+void StatRegistry::save(CheckpointWriter& out) const
+{
+    out.section("STRG");
+    out.put((uint64_t) m_groups.size());
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        const StatGroup& group = m_groups[g];
+        out.put((uint64_t) group.m_counters.size());
+        for (size_t i = 0; i < group.m_counters.size(); i++)
+        {
+            out.put(group.m_counters[i].value);
+        }
+        out.put((uint64_t) group.m_histograms.size());
+        for (size_t i = 0; i < group.m_histograms.size(); i++)
+        {
+            out.put(group.m_histograms[i]);
+        }
+    }
+}
+
+void StatRegistry::load(CheckpointReader& in)
+{
+    in.section("STRG");
+    if (in.get<uint64_t>() != m_groups.size())
+    {
+        in.fail("different statistics");
+    }
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        StatGroup& group = m_groups[g];
+        if (in.get<uint64_t>() != group.m_counters.size())
+        {
+            in.fail("different counters in " + group.m_name);
+        }
+        for (size_t i = 0; i < group.m_counters.size(); i++)
+        {
+            in.get(group.m_counters[i].value);
+        }
+        if (in.get<uint64_t>() != group.m_histograms.size())
+        {
+            in.fail("different histograms in " + group.m_name);
+        }
+        for (size_t i = 0; i < group.m_histograms.size(); i++)
+        {
+            in.get(group.m_histograms[i]);
+        }
+    }
+}
@@ -0,0 +1,150 @@
+/*
+// File: statistics.h
+//
+// Header file for the statistics registry. Every module registers its own
+// group of named counters and latency histograms once, at construction,
+// and updates them through the returned references on the hot path:
+//
+//   StatGroup&     g    = registry.group("cache0");
+//   StatCounter&   hits = g.counter("readhit");
+//   StatHistogram& lat  = g.histogram("latency");
+//   hits++;
+//   lat.sample(cycles);
+//
+// Counters and histograms are padded to a cache line each, so modules
+// updated from different host threads do not share lines. Histograms have
+// log2 buckets: bucket 0 counts the value 0 and bucket k the values in
+// [2^(k-1), 2^k).
+//
+// snapshot() records the counters and the histogram counts and sums at a
+// point in time. The registry is exported as JSON or CSV with all
+// snapshots and the final values.
+*/
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Size counters are padded to
+static const size_t STAT_LINE_SIZE = 64;
+
+// Number of log2 histogram buckets, enough for any uint64_t
+static const int STAT_BUCKETS = 65;
+
+struct StatCounter
+{
+    uint64_t value;
+    char     pad[STAT_LINE_SIZE - sizeof(uint64_t)];
+
+    void operator++(int)        { value++; }
+    void operator+=(uint64_t n) { value += n; }
+};
+
+struct StatHistogram
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[STAT_BUCKETS];
+    char     pad[STAT_LINE_SIZE - (4 + STAT_BUCKETS) * sizeof(uint64_t) % STAT_LINE_SIZE];
+
+    void sample(uint64_t v)
+    {
+        count++;
+        sum += v;
+        if (v < min)
+            min = v;
+        if (v > max)
+            max = v;
+        buckets[v == 0 ? 0 : 64 - __builtin_clzll(v)]++;
+    }
+
+    double mean() const { return count == 0 ? 0 : (double) sum / count; }
+
+    void clear();
+};
+
+class StatGroup
+{
+public:
+    explicit StatGroup(const std::string& name) : m_name(name) {}
+
+    // Registers a counter or histogram, or returns the one of that name
+    StatCounter&   counter(const std::string& name);
+    StatHistogram& histogram(const std::string& name);
+
+    // Value of a registered counter, 0 if there is none of that name
+    uint64_t value(const std::string& name) const;
+
+    // Registered histogram, NULL if there is none of that name
+    const StatHistogram* find_histogram(const std::string& name) const;
+
+    const std::string& name() const { return m_name; }
+
+private:
+    friend class StatRegistry;
+
+    std::string                m_name;
+    std::vector<std::string>   m_counter_names;
+    std::deque<StatCounter>    m_counters;      // deques keep references valid
+    std::vector<std::string>   m_histogram_names;
+    std::deque<StatHistogram>  m_histograms;
+};
+
+class StatRegistry
+{
+public:
+    // Creates a group, or returns the one of that name
+    StatGroup& group(const std::string& name);
+
+    const std::deque<StatGroup>& groups() const { return m_groups; }
+
+    // Records the current values, taken at the given cycle
+    void snapshot(uint64_t cycle);
+
+    // Sum of a counter over all groups that have it
+    uint64_t sum(const std::string& counter) const;
+
+    // Sum of a histogram over all groups that have it
+    StatHistogram total(const std::string& histogram) const;
+
+    /*
+     * Writes the final values, taken at the given cycle, and all snapshots.
+     * JSON has one object per group; CSV has one row per value, with
+     * columns cycle,group,name,value. Histograms appear as <name>.count,
+     * <name>.sum and, in the final values only, one <name>.lt<2^k> row per
+     * non-empty bucket.
+     */
+    void write_json(FILE* f, uint64_t cycle) const;
+    void write_csv(FILE* f, uint64_t cycle) const;
+
+    // Writes or restores all values, the registered groups must match
+    void save(CheckpointWriter& out) const;
+    void load(CheckpointReader& in);
+
+private:
+    struct Snapshot
+    {
+        uint64_t              cycle;
+        std::vector<uint64_t> values;   // in the order of flatten()
+    };
+
+    std::deque<StatGroup> m_groups;
+    std::vector<Snapshot> m_snapshots;
+
+    // Flat list of names ("group", "name") and current values of the
+    // counters and histogram counts and sums
+    void flatten(std::vector<std::pair<const std::string*, std::string> >* names,
+                 std::vector<uint64_t>* values) const;
+};
+
+#endif
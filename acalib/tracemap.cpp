@@ -0,0 +1,96 @@
+/*
+// File: tracemap.cpp
+//
+// Source file for the memory-mapped tracefile reader, see tracemap.h.
+*/
+
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tracemap.h"
+
+using namespace std;
+
+MappedTraceFile::MappedTraceFile(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 8)
+    {
+        ::close(fd);
+        throw runtime_error(string("Invalid file signature in file: ") + filename);
+    }
+    m_length = st.st_size;
+
+    void* p = mmap(NULL, m_length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw runtime_error(string("Unable to map file: ") + filename);
+    }
+    m_map = (const char*) p;
+    madvise(p, m_length, MADV_SEQUENTIAL);
+
+    // Check file signature
+    if (strncmp(m_map, "2TRF", 4))
+    {
+        munmap(p, m_length);
+        throw runtime_error(string("Invalid file signature in file: ") + filename);
+    }
+
+    // Read number of processors the file was created for
+    uint32_t procs_count;
+    memcpy(&procs_count, m_map + 4, sizeof(procs_count));
+    m_procs = ntohl(procs_count);
+    m_data  = (const uint32_t*) (m_map + 8);
+    m_words = (m_length - 8) / sizeof(uint32_t);
+
+    if (m_procs == 0 || m_words < m_procs)
+    {
+        munmap(p, m_length);
+        throw runtime_error(string("Unexpected end of tracefile: ") + filename);
+    }
+    rewind();
+}
+
+MappedTraceFile::~MappedTraceFile()
+{
+    munmap((void*) m_map, m_length);
+}
+
+void MappedTraceFile::rewind()
+{
+    m_positions.resize(m_procs);
+    for (uint32_t i = 0; i < m_procs; i++)
+    {
+        m_positions[i] = i;
+    }
+    m_num_finished = 0;
+}
+
+void MappedTraceFile::set_positions(const vector<uint64_t>& positions)
+{
+    if (positions.size() != m_procs)
+    {
+        throw runtime_error("Trace positions do not match the number of processors");
+    }
+    m_positions    = positions;
+    m_num_finished = 0;
+    for (uint32_t i = 0; i < m_procs; i++)
+    {
+        if (m_positions[i] >= m_words)
+        {
+            m_positions[i] = m_words;
+            m_num_finished++;
+        }
+    }
+}
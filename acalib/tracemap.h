@@ -0,0 +1,95 @@
+/*
+// File: tracemap.h
+//
+// Header file for the memory-mapped tracefile reader. MappedTraceFile reads
+// the same 2TRF files as TraceFile, with the same per-processor semantics,
+// but maps the file instead of seeking for every entry. That makes it fast
+// enough for the untimed simulators, and lets forked processes share one
+// copy of the trace in the page cache.
+*/
+
+#ifndef TRACEMAP_H
+#define TRACEMAP_H
+
+#include <stddef.h>
+#include <vector>
+#include <arpa/inet.h>
+#include "aca2009.h"
+
+class MappedTraceFile
+{
+public:
+    // Maps the file, throws runtime_error on failure
+    MappedTraceFile(const char* filename);
+    ~MappedTraceFile();
+
+    // Returns the number of processors this file contains traces for
+    uint32_t get_proc_count() const { return m_procs; }
+
+    // Number of whole 32-bit entries in the file, over all processors
+    uint64_t num_words() const { return m_words; }
+
+    // Decodes entry word w of the file, processor w % procs
+    void decode(uint64_t w, TraceFile::Entry& e) const
+    {
+        uint32_t data = ntohl(m_data[w]);
+        e.addr = data & ~0x3UL;
+        e.type = (TraceFile::EntryType) (data & 0x3);
+    }
+
+    /*
+     * Reads the next entry for the processor specified in pid, as
+     * TraceFile::next() does: ENTRY_TYPE_END is never returned, after the
+     * end of a trace only NOPs are read.
+     */
+    bool next(uint32_t pid, TraceFile::Entry& e)
+    {
+        if (pid >= m_procs)
+        {
+            return false;
+        }
+        uint64_t& pos = m_positions[pid];
+        if (pos >= m_words)
+        {
+            e.addr = 0;
+            e.type = TraceFile::ENTRY_TYPE_NOP;
+            return true;
+        }
+        decode(pos, e);
+        pos += m_procs;
+        if (e.type == TraceFile::ENTRY_TYPE_END)
+        {
+            e.type = TraceFile::ENTRY_TYPE_NOP;
+            pos = m_words;
+        }
+        if (pos >= m_words)
+        {
+            m_num_finished++;
+        }
+        return true;
+    }
+
+    // Determines if all traces have ended
+    bool eof() const { return m_num_finished == m_procs; }
+
+    // Restarts all traces from the beginning
+    void rewind();
+
+    // Reads or restores the next word index per processor
+    const std::vector<uint64_t>& get_positions() const { return m_positions; }
+    void set_positions(const std::vector<uint64_t>& positions);
+
+private:
+    const uint32_t*       m_data;       // first entry word
+    const char*           m_map;
+    size_t                m_length;
+    uint32_t              m_procs;
+    uint64_t              m_words;
+    std::vector<uint64_t> m_positions;  // next word per processor
+    uint32_t              m_num_finished;
+
+    // Private copy constructor because no copies are allowed.
+    MappedTraceFile(const MappedTraceFile&);
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+// File: tracewriter.cpp
+//
+// Source file for the buffered tracefile writer, see tracewriter.h.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include "tracewriter.h"
+
+using namespace std;
+
+// Words per write, 1 MiB
+static const size_t TRACEWRITER_BUFFER_WORDS = 256 * 1024;
+
+// Words per spill file write or read, 64 KiB
+static const size_t SPILL_BUFFER_WORDS = 16 * 1024;
+
+TraceWriter::TraceWriter(const char* filename, uint32_t procs)
+    : m_filename(filename), m_file(NULL), m_procs(procs), m_entries(0),
+      m_buffer(TRACEWRITER_BUFFER_WORDS), m_used(0)
+{
+    if (procs == 0)
+    {
+        throw runtime_error("A tracefile needs at least one processor");
+    }
+    m_file = fopen(filename, "wb");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to create file: ") + filename);
+    }
+
+    uint32_t header[2] = { 0, htonl(procs) };
+    memcpy(header, "2TRF", 4);
+    if (fwrite(header, sizeof(header), 1, m_file) != 1)
+    {
+        discard();
+        throw runtime_error(string("Unable to write file: ") + filename);
+    }
+}
+
+TraceWriter::~TraceWriter()
+{
+    discard();
+}
+
+void TraceWriter::discard()
+{
+    if (m_file != NULL)
+    {
+        fclose(m_file);
+        m_file = NULL;
+        remove(m_filename.c_str());
+    }
+}
+
+void TraceWriter::flush()
+{
+    if (m_used > 0 && fwrite(&m_buffer[0], sizeof(uint32_t), m_used, m_file) != m_used)
+    {
+        throw runtime_error("Unable to write file: " + m_filename);
+    }
+    m_used = 0;
+}
+
+void TraceWriter::end()
+{
+    while (next_proc() != 0)
+    {
+        write(TraceFile::ENTRY_TYPE_NOP);
+    }
+    for (uint32_t i = 0; i < m_procs; i++)
+    {
+        write(TraceFile::ENTRY_TYPE_END);
+    }
+}
+
+void TraceWriter::close()
+{
+    if (m_file == NULL)
+    {
+        return;
+    }
+    while (next_proc() != 0 || m_entries < 2 * (uint64_t) m_procs)
+    {
+        write(TraceFile::ENTRY_TYPE_NOP);
+    }
+    flush();
+
+    bool ok = (fclose(m_file) == 0);
+    m_file = NULL;
+    if (!ok)
+    {
+        remove(m_filename.c_str());
+        throw runtime_error("Unable to write file: " + m_filename);
+    }
+}
+
+StreamTraceWriter::StreamTraceWriter(const char* filename, uint32_t procs)
+    : m_filename(filename), m_closed(false)
+{
+    add_streams(procs);
+}
+
+StreamTraceWriter::~StreamTraceWriter()
+{
+    remove_spills();
+}
+
+string StreamTraceWriter::spill_name(uint32_t cpu) const
+{
+    char suffix[16];
+    sprintf(suffix, ".%u", cpu);
+    return m_filename + suffix;
+}
+
+void StreamTraceWriter::add_streams(uint32_t procs)
+{
+    while (m_streams.size() < procs)
+    {
+        uint32_t cpu = m_streams.size();
+        m_streams.push_back(Stream());
+        Stream& s = m_streams.back();
+        s.file    = fopen(spill_name(cpu).c_str(), "w+b");
+        s.used    = 0;
+        s.entries = 0;
+        if (s.file == NULL)
+        {
+            m_streams.pop_back();
+            throw runtime_error("Unable to create file: " + spill_name(cpu));
+        }
+        s.buffer.resize(SPILL_BUFFER_WORDS);
+    }
+}
+
+void StreamTraceWriter::remove_spills()
+{
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        Stream& s = m_streams[i];
+        if (s.file != NULL)
+        {
+            fclose(s.file);
+            s.file = NULL;
+            vector<uint32_t>().swap(s.buffer);
+            remove(spill_name(i).c_str());
+        }
+    }
+}
+
+void StreamTraceWriter::spill(Stream& s)
+{
+    if (s.used > 0 && fwrite(&s.buffer[0], sizeof(uint32_t), s.used, s.file) != s.used)
+    {
+        throw runtime_error("Unable to write spill file of " + m_filename);
+    }
+    s.used = 0;
+}
+
+void StreamTraceWriter::close()
+{
+    if (m_closed)
+    {
+        return;
+    }
+    m_closed = true;
+
+    // Every stream is followed by an end entry
+    uint32_t procs = max<size_t>(m_streams.size(), 1);
+    uint64_t rows  = 0;
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        Stream& s = m_streams[i];
+        spill(s);
+        rewind(s.file);
+        rows = max(rows, s.entries + 1);
+    }
+
+    TraceWriter out(m_filename.c_str(), procs);
+    bool        ok = true;
+    for (uint64_t r = 0; r < rows && ok; r++)
+    {
+        for (size_t i = 0; i < m_streams.size(); i++)
+        {
+            // The buffers now hold the words read back, s.used of them
+            // consumed
+            Stream& s = m_streams[i];
+            if (r < s.entries)
+            {
+                if (s.used == 0 || s.used == s.buffer.size())
+                {
+                    size_t n = min<uint64_t>(s.buffer.size(), s.entries - r);
+                    ok = ok && fread(&s.buffer[0], sizeof(uint32_t), n, s.file) == n;
+                    s.used = 0;
+                }
+                out.write_word(ntohl(s.buffer[s.used++]));
+            }
+            else
+            {
+                out.write(r == s.entries ? TraceFile::ENTRY_TYPE_END : TraceFile::ENTRY_TYPE_NOP);
+            }
+        }
+    }
+    remove_spills();
+    if (!ok)
+    {
+        // The destructor of out removes the incomplete tracefile
+        throw runtime_error("Unable to read spill files of " + m_filename);
+    }
+    out.close();
+}
@@ -0,0 +1,155 @@
+/*
+// File: tracewriter.h
+//
+// Header file for the buffered tracefile writer. TraceWriter produces the
+// 2TRF files read by TraceFile and MappedTraceFile: the signature, the
+// processor count, then the entries of all processors interleaved, one
+// big-endian word each. Entries are given in file order, so the i-th entry
+// belongs to processor i % procs, and go out through a fixed-size buffer,
+// so traces of any length are written in constant memory.
+//
+// Usage:
+//   TraceWriter w("out.trf", 4);
+//   for (...) w.write(TraceFile::ENTRY_TYPE_READ, addr);   // CPU 0, 1, 2, 3, 0, ...
+//   w.end();                                               // end all traces
+//   w.close();
+//
+// StreamTraceWriter takes the entries of every processor in any order, for
+// producers whose processors run at different rates. Each processor's
+// stream is spilled to its own temporary file, <filename>.<cpu>, and
+// close() interleaves them into <filename>, ending every stream with an end
+// entry. Streams are added on first use.
+//
+// Only an explicit close() completes a tracefile. The destructors do not
+// throw: a TraceWriter destroyed before close() removes its incomplete
+// file, and a StreamTraceWriter only removes its spill files, so an error
+// that unwinds past a writer leaves no tracefile behind.
+*/
+
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include "aca2009.h"
+
+class TraceWriter
+{
+public:
+    // Creates or truncates the file, throws runtime_error on failure
+    TraceWriter(const char* filename, uint32_t procs);
+
+    // Removes the file unless it was closed
+    ~TraceWriter();
+
+    uint32_t get_proc_count() const { return m_procs; }
+
+    // Processor the next entry belongs to
+    uint32_t next_proc() const { return m_entries % m_procs; }
+
+    // Appends the next entry in file order
+    void write(TraceFile::EntryType type, uint32_t addr = 0)
+    {
+        write_word((addr & ~0x3u) | type);
+    }
+
+    // Appends a raw, host-order entry word
+    void write_word(uint32_t word)
+    {
+        if (m_used == m_buffer.size())
+        {
+            flush();
+        }
+        m_buffer[m_used++] = htonl(word);
+        m_entries++;
+    }
+
+    // Completes the current row with NOPs, then ends every trace with a
+    // row of end entries
+    void end();
+
+    // Completes the current row with NOPs and closes the file. Files get at
+    // least two rows, the minimum TraceFile accepts.
+    void close();
+
+    // Entries written so far, over all processors
+    uint64_t entries() const { return m_entries; }
+
+private:
+    std::string           m_filename;
+    FILE*                 m_file;
+    uint32_t              m_procs;
+    uint64_t              m_entries;
+    std::vector<uint32_t> m_buffer;     // big-endian words
+    size_t                m_used;
+
+    void flush();
+
+    // Closes and removes an incomplete file
+    void discard();
+
+    // Private copy constructor because no copies are allowed.
+    TraceWriter(const TraceWriter&);
+};
+
+class StreamTraceWriter
+{
+public:
+    // Creates the spill files of the first procs processors, throws
+    // runtime_error on failure
+    StreamTraceWriter(const char* filename, uint32_t procs = 0);
+
+    // Removes the spill files, without writing the tracefile
+    ~StreamTraceWriter();
+
+    // Appends an entry to the stream of cpu
+    void write(uint32_t cpu, TraceFile::EntryType type, uint32_t addr = 0)
+    {
+        if (cpu >= m_streams.size())
+        {
+            add_streams(cpu + 1);
+        }
+        Stream& s = m_streams[cpu];
+        if (s.used == s.buffer.size())
+        {
+            spill(s);
+        }
+        s.buffer[s.used++] = htonl((addr & ~0x3u) | type);
+        s.entries++;
+    }
+
+    uint32_t get_proc_count() const { return m_streams.size(); }
+
+    // Entries of cpu so far
+    uint64_t entries(uint32_t cpu) const { return m_streams[cpu].entries; }
+
+    // Writes the tracefile and removes the spill files. The counts stay
+    // available, further writes are not allowed.
+    void close();
+
+private:
+    struct Stream
+    {
+        FILE*                 file;
+        std::vector<uint32_t> buffer;   // big-endian words
+        size_t                used;
+        uint64_t              entries;
+    };
+
+    std::string         m_filename;
+    std::vector<Stream> m_streams;
+    bool                m_closed;
+
+    std::string spill_name(uint32_t cpu) const;
+    void add_streams(uint32_t procs);
+    void spill(Stream& s);
+    void remove_spills();
+
+    // Private copy constructor because no copies are allowed.
+    StreamTraceWriter(const StreamTraceWriter&);
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+// File: wavetrace.cpp
+//
+// Source file for the compact binary waveform format, see wavetrace.h.
+*/
+
+#include <stdexcept>
+#include <string.h>
+#include "wavetrace.h"
+
+using namespace std;
+
+static const uint32_t WAVETRACE_VERSION = 1;
+
+// stdio buffer size for both directions
+static const size_t WAVETRACE_BUFFER_SIZE = 1 << 20;
+
+WaveTraceWriter::WaveTraceWriter(const char* filename, uint64_t timescale_ps)
+    : m_timescale(timescale_ps), m_time(0), m_started(false), m_buffer(WAVETRACE_BUFFER_SIZE)
+{
+    m_file = fopen(filename, "wb");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to create wave trace: ") + filename);
+    }
+    setvbuf(m_file, &m_buffer[0], _IOFBF, m_buffer.size());
+}
+
+WaveTraceWriter::~WaveTraceWriter()
+{
+    close();
+}
+
+uint32_t WaveTraceWriter::add_signal(const string& name, unsigned width)
+{
+    if (m_started)
+    {
+        throw runtime_error("Wave trace signals must be defined before the first record");
+    }
+    WaveSignal s;
+    s.name  = name;
+    s.width = (width > 64) ? 64 : width;
+    m_signals.push_back(s);
+    return m_signals.size() - 1;
+}
+
+void WaveTraceWriter::put_varint(uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        putc((int) (v & 0x7F) | 0x80, m_file);
+        v >>= 7;
+    }
+    putc((int) v, m_file);
+}
+
+void WaveTraceWriter::start()
+{
+    fwrite("WTRC", 1, 4, m_file);
+    put_varint(WAVETRACE_VERSION);
+    put_varint(m_timescale);
+    put_varint(m_signals.size());
+    for (size_t i = 0; i < m_signals.size(); i++)
+    {
+        put_varint(m_signals[i].width);
+        put_varint(m_signals[i].name.size());
+        fwrite(m_signals[i].name.data(), 1, m_signals[i].name.size(), m_file);
+    }
+    m_started = true;
+}
+
+void WaveTraceWriter::record(WaveRecordType type, uint64_t time)
+{
+    if (!m_started)
+    {
+        start();
+    }
+    putc(type, m_file);
+    put_varint(time - m_time);
+    m_time = time;
+}
+
+void WaveTraceWriter::dump_on(uint64_t time, const vector<uint64_t>& values)
+{
+    record(WAVE_DUMPON, time);
+    for (size_t i = 0; i < m_signals.size(); i++)
+    {
+        change(time, i, i < values.size() ? values[i] : 0);
+    }
+}
+
+void WaveTraceWriter::dump_off(uint64_t time)
+{
+    record(WAVE_DUMPOFF, time);
+}
+
+void WaveTraceWriter::change(uint64_t time, uint32_t id, uint64_t value)
+{
+    record(WAVE_CHANGE, time);
+    put_varint(id);
+    put_varint(value);
+}
+
+void WaveTraceWriter::close()
+{
+    if (m_file != NULL)
+    {
+        if (!m_started)
+        {
+            start();
+        }
+        fclose(m_file);
+        m_file = NULL;
+    }
+}
+
+WaveTraceReader::WaveTraceReader(const char* filename)
+    : m_time(0), m_buffer(WAVETRACE_BUFFER_SIZE)
+{
+    m_file = fopen(filename, "rb");
+    if (m_file == NULL)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+    setvbuf(m_file, &m_buffer[0], _IOFBF, m_buffer.size());
+
+    char signature[4];
+    uint64_t version, count;
+    if (fread(signature, 1, 4, m_file) != 4 || strncmp(signature, "WTRC", 4) ||
+        !get_varint(version) || version != WAVETRACE_VERSION ||
+        !get_varint(m_timescale) || !get_varint(count))
+    {
+        fclose(m_file);
+        throw runtime_error(string("Invalid wave trace: ") + filename);
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t width, length;
+        if (!get_varint(width) || !get_varint(length))
+        {
+            fclose(m_file);
+            throw runtime_error(string("Unexpected end of wave trace: ") + filename);
+        }
+        WaveSignal s;
+        s.width = width;
+        s.name.resize(length);
+        if (length > 0 && fread(&s.name[0], 1, length, m_file) != length)
+        {
+            fclose(m_file);
+            throw runtime_error(string("Unexpected end of wave trace: ") + filename);
+        }
+        m_signals.push_back(s);
+    }
+}
+
+WaveTraceReader::~WaveTraceReader()
+{
+    fclose(m_file);
+}
+
+bool WaveTraceReader::get_varint(uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(m_file);
+        if (c == EOF)
+        {
+            return false;
+        }
+        v |= (uint64_t) (c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WaveTraceReader::next(WaveRecord& r)
+{
+    int type = getc(m_file);
+    uint64_t delta;
+    if (type == EOF || type > WAVE_DUMPOFF || !get_varint(delta))
+    {
+        return false;
+    }
+    m_time += delta;
+    r.type  = (WaveRecordType) type;
+    r.time  = m_time;
+    r.id    = 0;
+    r.value = 0;
+
+    if (r.type == WAVE_CHANGE)
+    {
+        uint64_t id;
+        if (!get_varint(id) || !get_varint(r.value) || id >= m_signals.size())
+        {
+            return false;
+        }
+        r.id = id;
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+/*
+// File: wavetrace.h
+//
+// Header file for the compact binary waveform format written by the
+// windowed tracer of the cache simulator, and read back by wave2vcd.
+//
+// Layout: the signature "WTRC", the format version, the length of a time
+// unit in picoseconds and the signal definitions (name and bit width),
+// followed by a stream of records. Every record is a type byte followed by
+// LEB128 varints:
+//
+//   WAVE_CHANGE   time delta, signal id, value
+//   WAVE_DUMPON   time delta; followed by one WAVE_CHANGE for every signal
+//   WAVE_DUMPOFF  time delta
+//
+// Times are deltas from the previous record. Values are at most 64 bits.
+*/
+
+#ifndef WAVETRACE_H
+#define WAVETRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum WaveRecordType
+{
+    WAVE_CHANGE  = 0,
+    WAVE_DUMPON  = 1,
+    WAVE_DUMPOFF = 2
+};
+
+struct WaveSignal
+{
+    std::string name;
+    unsigned    width;
+};
+
+struct WaveRecord
+{
+    WaveRecordType type;
+    uint64_t       time;
+    uint32_t       id;
+    uint64_t       value;
+};
+
+class WaveTraceWriter
+{
+public:
+    // Creates the file, throws runtime_error on failure
+    WaveTraceWriter(const char* filename, uint64_t timescale_ps);
+    ~WaveTraceWriter();
+
+    // Defines a signal and returns its id, only before the first record
+    uint32_t add_signal(const std::string& name, unsigned width);
+
+    // Starts a window, values holds the current value of every signal
+    void dump_on(uint64_t time, const std::vector<uint64_t>& values);
+
+    // Ends a window
+    void dump_off(uint64_t time);
+
+    // Records a new value of a signal
+    void change(uint64_t time, uint32_t id, uint64_t value);
+
+    void close();
+
+private:
+    FILE*                   m_file;
+    uint64_t                m_timescale;
+    uint64_t                m_time;
+    bool                    m_started;
+    std::vector<WaveSignal> m_signals;
+    std::vector<char>       m_buffer;
+
+    void start();
+    void record(WaveRecordType type, uint64_t time);
+    void put_varint(uint64_t v);
+
+    // Private copy constructor because no copies are allowed.
+    WaveTraceWriter(const WaveTraceWriter&);
+};
+
+class WaveTraceReader
+{
+public:
+    // Opens the file and reads the header, throws runtime_error on failure
+    WaveTraceReader(const char* filename);
+    ~WaveTraceReader();
+
+    const std::vector<WaveSignal>& signals() const { return m_signals; }
+    uint64_t timescale_ps() const { return m_timescale; }
+
+    // Reads the next record, returns false at the end of the file
+    bool next(WaveRecord& r);
+
+private:
+    FILE*                   m_file;
+    uint64_t                m_timescale;
+    uint64_t                m_time;
+    std::vector<WaveSignal> m_signals;
+    std::vector<char>       m_buffer;
+
+    bool get_varint(uint64_t& v);
+
+    // Private copy constructor because no copies are allowed.
+    WaveTraceReader(const WaveTraceReader&);
+};
+
+#endif
@@ -0,0 +1,380 @@
+/*
+// File: bench.cpp
+//
+// End-to-end benchmark harness. Runs a simulator binary over a set of
+// tracefiles, by default every tracefile in tracefiles/, and measures per
+// tracefile the host wall time (median of --runs runs), the peak resident
+// set size, and the simulated cycles and accesses per host second, parsed
+// from the simulator's output ("Simulated cycles:" and the statistics
+// table). Any simulator printing the stats_print() table works, e.g. the
+// cache simulator or funcsim.
+//
+// Results are printed as a table and can be stored as a JSON baseline
+// with --json. --compare reads such a baseline and flags every tracefile
+// whose wall time or peak RSS grew by more than --threshold percent; the
+// exit code is then 1. A wall time must also have grown by at least
+// --min-diff milliseconds (default 20), as runs of a few milliseconds vary
+// by tens of percent from run to run.
+//
+// Usage: bench <simulator> [--runs <n>] [--json <file>] [--compare <file>]
+//              [--threshold <percent>] [--min-diff <ms>] [<tracefile>...]
+//              [-- <simulator options>]
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "hosttime.h"
+
+using namespace std;
+
+// Measurements of one tracefile
+struct BenchResult
+{
+    string   trace;
+    double   wall;          // seconds, median over the runs
+    long     rss;           // peak resident set size in KiB, maximum over the runs
+    uint64_t cycles;        // simulated cycles, 0 if not reported
+    uint64_t accesses;
+};
+
+static string base_name(const string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// Every *.trf file in dir, sorted
+static vector<string> list_tracefiles(const char* dir)
+{
+    vector<string> files;
+    DIR* d = opendir(dir);
+    if (d == NULL)
+    {
+        throw runtime_error(string("Unable to open directory: ") + dir);
+    }
+    while (dirent* e = readdir(d))
+    {
+        size_t len = strlen(e->d_name);
+        if (len > 4 && strcmp(e->d_name + len - 4, ".trf") == 0)
+        {
+            files.push_back(string(dir) + "/" + e->d_name);
+        }
+    }
+    closedir(d);
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// Runs the simulator once, returns its output and fills in time and RSS
+static string run_once(const vector<string>& args, double* wall, long* rss)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw runtime_error("Unable to create a pipe");
+    }
+
+    double start = host_seconds();
+    pid_t  pid   = fork();
+    if (pid < 0)
+    {
+        throw runtime_error("Unable to fork");
+    }
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        vector<char*> argv;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            argv.push_back(const_cast<char*>(args[i].c_str()));
+        }
+        argv.push_back(NULL);
+        execv(argv[0], &argv[0]);
+        fprintf(stderr, "Unable to execute %s\n", argv[0]);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    string  output;
+    char    buffer[65536];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+        output.append(buffer, n);
+    }
+    close(fds[0]);
+
+    int    status;
+    rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid)
+    {
+        throw runtime_error("Unable to wait for the simulator");
+    }
+    *wall = host_seconds() - start;
+    *rss  = usage.ru_maxrss;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        throw runtime_error("Simulator failed on " + args[1] + ":\n" + output);
+    }
+    return output;
+}
+
+// Reads the simulated cycles and the accesses of the statistics table
+static void parse_output(const string& output, BenchResult& r)
+{
+    r.cycles   = 0;
+    r.accesses = 0;
+
+    bool   table = false;
+    size_t pos   = 0;
+    while (pos < output.size())
+    {
+        size_t end = output.find('\n', pos);
+        if (end == string::npos)
+        {
+            end = output.size();
+        }
+        string line = output.substr(pos, end - pos);
+        pos = end + 1;
+
+        unsigned long long cpu, reads, rhit, rmiss, writes, cycles;
+        if (line.compare(0, 14, "CPU\tReads\tRHit") == 0)
+        {
+            table = true;
+        }
+        else if (table && sscanf(line.c_str(), "%llu %llu %llu %llu %llu", &cpu, &reads, &rhit, &rmiss, &writes) == 5)
+        {
+            r.accesses += reads + writes;
+        }
+        else
+        {
+            table = false;
+            if (sscanf(line.c_str(), "Simulated cycles: %llu", &cycles) == 1)
+            {
+                r.cycles = cycles;
+            }
+        }
+    }
+}
+
+static BenchResult run_trace(const string& simulator, const string& trace, const vector<string>& options,
+                             int runs)
+{
+    vector<string> args;
+    args.push_back(simulator);
+    args.push_back(trace);
+    args.insert(args.end(), options.begin(), options.end());
+
+    BenchResult    r;
+    vector<double> walls;
+    r.trace = base_name(trace);
+    r.rss   = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        double wall;
+        long   rss;
+        string output = run_once(args, &wall, &rss);
+        parse_output(output, r);
+        walls.push_back(wall);
+        r.rss = max(r.rss, rss);
+    }
+    sort(walls.begin(), walls.end());
+    r.wall = walls[walls.size() / 2];
+    return r;
+}
+
+static void write_json(FILE* f, const vector<BenchResult>& results)
+{
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(f, "  {\"trace\": \"%s\", \"wall\": %f, \"rss\": %ld, \"cycles\": %llu, \"accesses\": %llu, "
+                "\"cycles_per_s\": %f, \"accesses_per_s\": %f}%s\n",
+                r.trace.c_str(), r.wall, r.rss, (unsigned long long) r.cycles, (unsigned long long) r.accesses,
+                r.cycles / r.wall, r.accesses / r.wall, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "]\n");
+}
+
+// Reads a baseline written by write_json()
+static vector<BenchResult> read_json(const char* filename)
+{
+    FILE* f = fopen(filename, "r");
+    if (f == NULL)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    vector<BenchResult> results;
+    char line[1024];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char               trace[256];
+        double             wall;
+        long               rss;
+        unsigned long long cycles, accesses;
+        if (sscanf(line, " {\"trace\": \"%255[^\"]\", \"wall\": %lf, \"rss\": %ld, \"cycles\": %llu, \"accesses\": %llu",
+                   trace, &wall, &rss, &cycles, &accesses) == 5)
+        {
+            BenchResult r = { trace, wall, rss, cycles, accesses };
+            results.push_back(r);
+        }
+    }
+    fclose(f);
+
+    if (results.empty())
+    {
+        throw runtime_error(string("No results in baseline: ") + filename);
+    }
+    return results;
+}
+
+static void print_results(const vector<BenchResult>& results)
+{
+    printf("Trace\tWall(s)\tRSS(KiB)\tCycles\tAccesses\tCycles/s\tAccesses/s\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        printf("%s\t%f\t%ld\t%llu\t%llu\t%.0f\t%.0f\n", r.trace.c_str(), r.wall, r.rss,
+               (unsigned long long) r.cycles, (unsigned long long) r.accesses,
+               r.cycles / r.wall, r.accesses / r.wall);
+    }
+}
+
+// Prints the changes against the baseline, returns the number of regressions
+static int compare(const vector<BenchResult>& results, const vector<BenchResult>& baseline, double threshold,
+                   double min_diff)
+{
+    int regressions = 0;
+    printf("\nTrace\tWall\tRSS\tStatus\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        const BenchResult* b = NULL;
+        for (size_t j = 0; j < baseline.size() && b == NULL; j++)
+        {
+            if (baseline[j].trace == r.trace)
+            {
+                b = &baseline[j];
+            }
+        }
+        if (b == NULL)
+        {
+            printf("%s\t-\t-\tnot in baseline\n", r.trace.c_str());
+            continue;
+        }
+
+        double wall = 100.0 * (r.wall - b->wall) / b->wall;
+        double rss  = 100.0 * (r.rss - b->rss) / b->rss;
+        bool   slow = (wall > threshold && r.wall - b->wall >= min_diff) || rss > threshold;
+        const char* status = slow ? "REGRESSION" : "ok";
+        if (r.cycles != b->cycles || r.accesses != b->accesses)
+        {
+            // Different work, the timings are not comparable
+            status = slow ? "REGRESSION, results differ" : "results differ";
+        }
+        printf("%s\t%+.1f%%\t%+.1f%%\t%s\n", r.trace.c_str(), wall, rss, status);
+        regressions += slow;
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+    const char*    simulator = NULL;
+    const char*    jsonfile  = NULL;
+    const char*    basefile  = NULL;
+    int            runs      = 3;
+    double         threshold = 5;
+    double         min_diff  = 20;
+    vector<string> traces, options;
+    bool           usage     = argc < 2;
+
+    for (int i = 1; i < argc && !usage; i++)
+    {
+        string      opt   = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (opt == "--")
+        {
+            options.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else if (opt == "--runs" && value != NULL && (runs = atoi(value)) > 0)
+            i++;
+        else if (opt == "--json" && value != NULL)
+            jsonfile = argv[++i];
+        else if (opt == "--compare" && value != NULL)
+            basefile = argv[++i];
+        else if (opt == "--threshold" && value != NULL)
+            threshold = atof(argv[++i]);
+        else if (opt == "--min-diff" && value != NULL)
+            min_diff = atof(argv[++i]);
+        else if (opt[0] == '-')
+            usage = true;
+        else if (simulator == NULL)
+            simulator = argv[i];
+        else
+            traces.push_back(opt);
+    }
+
+    if (usage || simulator == NULL)
+    {
+        fprintf(stderr, "Error, usage: %s <simulator> [--runs <n>] [--json <file>] [--compare <file>] "
+                "[--threshold <percent>] [--min-diff <ms>] [<tracefile>...] [-- <simulator options>]\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        if (traces.empty())
+        {
+            traces = list_tracefiles("tracefiles");
+        }
+
+        vector<BenchResult> results;
+        for (size_t i = 0; i < traces.size(); i++)
+        {
+            results.push_back(run_trace(simulator, traces[i], options, runs));
+        }
+        print_results(results);
+
+        if (jsonfile != NULL)
+        {
+            FILE* f = fopen(jsonfile, "w");
+            if (f == NULL)
+            {
+                throw runtime_error(string("Unable to create file: ") + jsonfile);
+            }
+            write_json(f, results);
+            fclose(f);
+        }
+
+        if (basefile != NULL)
+        {
+            int regressions = compare(results, read_json(basefile), threshold, min_diff / 1000);
+            printf("%d regressions above %.1f%%, and %.0f ms of wall time\n", regressions, threshold, min_diff);
+            return regressions > 0 ? 1 : 0;
+        }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
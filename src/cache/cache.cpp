@@ -1,20 +1,59 @@
 #include "aca2009.h"
+#include "cachecore.h"
+#include "missclass.h"
+#include "sampler.h"
+#include "checkpoint.h"
+#include "statistics.h"
+#include "interval.h"
+#include "bustrace.h"
+#include "backingstore.h"
+#include "config.h"
+#include "hostprof.h"
+#include "hosttime.h"
+#include "log.h"
+#include "eventlog.h"
+#include "windowtracer.h"
 #include <systemc.h>
+#include <algorithm>
 #include <iostream>
 #include <list>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 
 #define SC_DEFAULT_WRITER_POLICY SC_MANY_WRITERS
 
+// The CPU and the cache controller are SC_THREADs by default. Compile with
+// -DCACHE_USE_SC_METHOD to use the clocked SC_METHOD state machines instead,
+// which avoid a coroutine context switch on every wait().
+//
+// Compile with -DCACHE_FAST_FORWARD to skip idle cycles: every module waits
+// for its next clock edge with a timed wait instead of static sensitivity,
+// and a cache waiting for the bus sleeps until it is released. The clock
+// is then gated off entirely, so the kernel jumps straight from one cycle
+// with work to the next.
 
 using namespace std;
 
-static const int NUM_SETS = 128;
-static const int NUM_LINES = 8;
-static const int MRU_POSITION = 0;
+// Parameters of the simulated system, from --config files and --set
+// assignments, see read_config(). The modules copy what they need when
+// they are constructed, so no access looks anything up.
+struct SystemConfig
+{
+  uint32_t sets;              // cache.sets
+  uint32_t ways;              // cache.ways
+  uint32_t lineSize;          // cache.line, bytes
+  ReplacementPolicy policy;   // cache.policy
+  int memLatency;             // memory.latency, cycles per line fill
+  int busCycles;              // bus.cycles, cycles a transfer holds the bus
+  double clockPeriodNs;       // clock.period_ns
+};
+
+// Clock period, set from the configuration before elaboration
+sc_time clockPeriod;
 
 sc_mutex traceFileMtx;
 sc_mutex doneProcessesMtx;
@@ -47,10 +86,79 @@ enum RetCode
   RET_WRITE_DONE
 };
 
-double hitRate, missRate;
+// Counters and latency histograms of all modules, see statistics.h
+StatRegistry statistics;
+
+// Interval statistics and phases, enabled with --intervals <file>
+IntervalSampler* intervals = NULL;
+
+// Bus requests of all caches as a tracefile, enabled with --bus-trace <file>
+BusTraceWriter* bustrace = NULL;
+
+// Sorts the misses of every cache into 3C and coherence misses, enabled
+// with --classify
+bool classifyMisses = false;
+
+// Main memory behind the bus. Caches read lines from it on a miss and
+// write dirty lines back when they are replaced.
+BackingStore memory;
+
+// Memory as every write leaves it, in the order the caches perform them,
+// enabled with --check-values. A read returning anything else got stale
+// data.
+BackingStore* reference = NULL;
+
+// Current simulation time in clock cycles
+uint64_t current_cycle()
+{
+  return sc_time_stamp().value() / clockPeriod.value();
+}
+
+// Time from now to the n-th next rising clock edge
+sc_time cycles_ahead(int n)
+{
+  uint64_t edge = sc_time_stamp().value() / clockPeriod.value() + n;
+  return clockPeriod * (double) edge - sc_time_stamp();
+}
+
+// Waiting for the next clock edges, from threads and from methods
+#ifdef CACHE_FAST_FORWARD
+inline void wait_cycles(int n = 1) { wait(cycles_ahead(n)); }
+inline void next_cycle(const sc_in<bool>&, int n = 1) { next_trigger(cycles_ahead(n)); }
+#else
+inline void wait_cycles(int n = 1) { wait(n); }
+inline void next_cycle(const sc_in<bool>& clk, int n = 1) {
+  if (n == 1) {
+    next_trigger(clk.posedge_event());
+  } else {
+    next_trigger(cycles_ahead(n));
+  }
+}
+#endif
+
+// Per-access event recorder, enabled with --eventlog <file>
+EventLogWriter* eventlog = NULL;
+
+// Windowed waveform tracer, enabled with --wavetrace <file>
+WindowTracer* wavetracer = NULL;
+
+// Sampled simulation, enabled with --sample <period>:<window>[:<warmup>]
+Sampler* sampler = NULL;
 
-// Initialize logger object
-std::ofstream logger("logger.log", std::ios_base::out | std::ios_base::trunc);
+// Checkpoint saved once every CPU has fetched checkpointAt trace entries,
+// enabled with --checkpoint-save <file>:<entries>
+const char* checkpointFile = NULL;
+uint64_t checkpointAt = 0;
+int numProcessesAtCheckpoint = 0;
+
+// Set when a CPU ended its trace before reaching the checkpoint
+bool checkpointMissed = false;
+
+// Writes the checkpoint, defined after the modules it covers
+void save_checkpoint();
+
+// Name of the log file, written through the LOG_* macros of log.h
+static const char* LOG_FILE = "logger.log";
 
 // Simple Bus interface
 class Bus_if : public virtual sc_interface
@@ -58,6 +166,14 @@ class Bus_if : public virtual sc_interface
 public:
   virtual bool read(int writer, int addr) = 0;
   virtual bool write(int writer, int addr, int data) = 0;
+
+  // Non-blocking access for SC_METHOD callers: request() tries to take the
+  // bus and drive it, release() ends the transaction one cycle later.
+  virtual bool request(int writer, int addr, Function f) = 0;
+  virtual void release() = 0;
+
+  // Notified a delta cycle after every release()
+  virtual const sc_event& released_event() const = 0;
 };
 
 /* Bus class, provides a way to share one memory in multiple CPU + Caches. */
@@ -73,89 +189,113 @@ public:
 
   /* Bus mutex. */
   sc_mutex busMtx;
+  sc_event releasedEvent;
+
+  /* Statistics. */
+  StatCounter& waits;
+  StatCounter& reads;
+  StatCounter& writes;
 
-  /* Variables. */
-  long waits;
-  long reads;
-  long writes;
+  /* Cycles a transfer holds the bus. */
+  const int transferCycles;
 
   // has to be added when no standard constructor SC_CTOR is used
   SC_HAS_PROCESS(Bus);
 
 public:
   /* Constructor. */
-  Bus(sc_module_name name) : sc_module(name)
+  Bus(sc_module_name name, const SystemConfig& config) : sc_module(name),
+    waits(statistics.group("bus").counter("waits")),
+    reads(statistics.group("bus").counter("reads")),
+    writes(statistics.group("bus").counter("writes")),
+    transferCycles(config.busCycles)
   {
     /* Handle Port_CLK to simulate delay */
     sensitive << Port_CLK.pos();
 
     // Initialize some bus properties
     Port_BusAddr.write("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ");
-
-    /* Update variables. */
-    waits = 0;
-    reads = 0;
-    writes = 0;
   }
 
   /* Perform a read access to memory addr for CPU #writer. */
   virtual bool read(int writer, int addr){
-    /* Try to get exclusive lock on bus. */
-    while(busMtx.trylock() == -1){
-      /* Wait when bus is in contention. */
-      waits++;
-      wait();
+    /* Wait when bus is in contention. */
+    while(!request(writer, addr, F_READ)){
+      waitForBus();
     }
 
-    /* Update number of bus accesses. */
-    reads++;
-
-    /* Set lines. */
-    Port_BusAddr.write(addr);
-    Port_BusWriter.write(writer);
-    Port_BusFunction.write(F_READ);
-
     /* Wait for everyone to recieve. */
-    wait();
-
-    /* Reset. */
-    Port_BusFunction.write(F_INVALID);
-    Port_BusAddr.write("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ");
-    busMtx.unlock();
+    wait_cycles(transferCycles);
+    release();
 
     return(true);
   };
 
   /* Write action to memory, need to know the writer, address and data. */
   virtual bool write(int writer, int addr, int data){
-    /* Try to get exclusive lock on the bus. */
-    while(busMtx.trylock() == -1){
+    while(!request(writer, addr, F_WRITE)){
+      waitForBus();
+    }
+
+    /* Wait for everyone to recieve. */
+    wait_cycles(transferCycles);
+    release();
+
+    return(true);
+  }
+
+  /* Try to get exclusive lock on the bus and set the lines. */
+  virtual bool request(int writer, int addr, Function f){
+    HOST_PROFILE_SCOPE("bus.request");
+    if(busMtx.trylock() == -1){
       waits++;
-      wait();
+      return(false);
     }
 
-    /* Update number of accesses. */
-    writes++;
+    /* Update number of bus accesses. */
+    if(f == F_READ){
+      reads++;
+    } else {
+      writes++;
+    }
 
-    /* Set. */
+    /* Set lines. */
     Port_BusAddr.write(addr);
     Port_BusWriter.write(writer);
-    Port_BusFunction.write(F_WRITE);
+    Port_BusFunction.write(f);
 
-    /* Wait for everyone to recieve. */
-    wait();
+    return(true);
+  }
 
-    /* Reset. */
+  /* Reset the lines and give up the bus. */
+  virtual void release(){
+    HOST_PROFILE_SCOPE("bus.release");
     Port_BusFunction.write(F_INVALID);
     Port_BusAddr.write("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ");
     busMtx.unlock();
+    releasedEvent.notify(SC_ZERO_TIME);
+  }
 
-    return(true);
+  virtual const sc_event& released_event() const {
+    return releasedEvent;
+  }
+
+  /* Wait until the bus may have become free: poll again next cycle, or
+  sleep until the holder releases it when fast-forwarding. */
+  void waitForBus(){
+#ifdef CACHE_FAST_FORWARD
+    wait(releasedEvent);
+#else
+    wait();
+#endif
   }
 
   /* Bus output. */
   void output(){
     /* Write output as specified in the assignment. */
+    long waits = this->waits.value;
+    long reads = this->reads.value;
+    long writes = this->writes.value;
     double avg = (double)waits / double(reads + writes);
     printf("\n 2. Main memory access rates\n");
     printf("    Bus had %ld reads and %ld writes.\n", reads, writes);
@@ -166,6 +306,14 @@ public:
   }
 };
 
+// Name of the statistics group of a per-CPU module, e.g. "cache0"
+string stat_group(const char* module, int pid)
+{
+  char name[32];
+  sprintf(name, "%s%d", module, pid);
+  return name;
+}
+
 //SC_MODULE(Cache)
 class Cache : public sc_module
 {
@@ -198,103 +346,411 @@ public:
   // has to be added when no standard constructor SC_CTOR is used
   SC_HAS_PROCESS(Cache);
 
-  // Inner Classes
-  class Line {
-  public:
-    int   tag;
-    int   data;
-    bool  isValid;
-    Line() {
-      tag = -1;
-      data = 0;
-      isValid = false;
+  // Custom constructor
+  Cache(sc_module_name nm, int pid, const SystemConfig& config)
+  : sc_module(nm), pid_(pid),
+    lineSize_(config.lineSize), memLatency_(config.memLatency), busCycles_(config.busCycles),
+    core_(config.sets, config.ways, config.lineSize, config.policy, true),
+    classifier_(classifyMisses ? new MissClassifier(config.sets * config.ways, config.lineSize) : NULL),
+    stats_(statistics.group(stat_group("cache", pid))),
+    readHits_(stats_.counter("readhit")),
+    readMisses_(stats_.counter("readmiss")),
+    writeHits_(stats_.counter("writehit")),
+    writeMisses_(stats_.counter("writemiss")),
+    staleReads_(stats_.counter("stale_reads")),
+    latency_(stats_.histogram("latency")),
+    busAcquire_(stats_.histogram("bus_acquire")) {
+
+#ifdef CACHE_USE_SC_METHOD
+    state_ = ST_IDLE;
+    memDelay_ = memLatency_ * clockPeriod;
+
+    SC_METHOD(snoop);
+    sensitive << Port_BusFunction;
+    dont_initialize();
+
+    SC_METHOD(execute);
+    sensitive << Port_CpuFunc;
+    dont_initialize();
+#else
+    SC_THREAD(snoop);
+    SC_THREAD(execute);
+    sensitive << Port_CLK.pos();
+    // Perhaps dont_initialize() can be executed
+    //dont_initialize();
+#endif
+  }
+
+  /* Functional access, keeps the cache warm between sampling windows.
+  It updates the lines and the statistics but takes no time and leaves the
+  ports and the bus alone. */
+  void warm(Function f, int addr) {
+    HOST_PROFILE_SCOPE("cache.warm");
+    int index = core_.index(addr);
+    int tag   = core_.tag(addr);
+    int way   = core_.find(index, tag);
+    bool hit  = way > -1;
+    if (hit) {
+      core_.touch(index, way);
+    } else {
+      way = allocate(index, tag);
     }
-  };
+    if (f == F_WRITE) {
+      store(index, way, addr, rand());
+    } else {
+      checkRead(index, way, addr);
+    }
+    if (classifier_ != NULL) {
+      classifier_->access(addr, hit);
+    }
+    countAccess(f, hit);
+    if (intervals != NULL) {
+      intervals->access(addr, current_cycle());
+    }
+  }
 
-  class Set {
-  public:
-    int numOfEntries;
-    Line line[NUM_LINES];
-    Set (){
-      numOfEntries = 0;
-    };
-
-    int findTag (int tag) {
-      for(int i=0 ; i<NUM_LINES ; i++){
-        if (line[i].tag == tag){
-          return i;
-        }
-      }
-      return -1;
+  ~Cache() {
+    delete classifier_;
+  }
+
+  /* Compulsory, capacity, conflict and coherence misses so far, NULL
+  without --classify. */
+  const MissClassifier* classifier() const { return classifier_; }
+
+  /* Write or restore the lines and the miss classifier. Only valid while
+  the cache is idle. */
+  void save(CheckpointWriter& out) const {
+    core_.save(out);
+    out.put(classifier_ != NULL);
+    if (classifier_ != NULL) {
+      classifier_->save(out);
     }
+  }
 
-    /* Shift all lines right up to the added line position.
-    If the set is full, the entry from its last position is deleted. */
-    void shiftLinesMiss(int numOfEntries) {
-      for(int i = numOfEntries; i > 1 ; i--) {
-        line[i-1] = line[i-2];
-      }
+  void load(CheckpointReader& in) {
+    core_.load(in);
+    // The classes are only known if the checkpointed run kept them
+    if (in.get<bool>()) {
+      MissClassifier discarded(core_.num_sets() * core_.num_ways(), core_.line_size());
+      (classifier_ != NULL ? *classifier_ : discarded).load(in);
+    } else if (classifier_ != NULL) {
+      in.fail("saved without --classify");
+    }
+  }
+
+private:
+  int pid_;
+
+  // Line size in bytes, and cycles of a line fill and of a bus transfer
+  const uint32_t lineSize_;
+  const int      memLatency_;
+  const int      busCycles_;
+
+  // Sets, lines and replacement state
+  CacheCore core_;
+
+  // Sorts every miss into its 3C class, or NULL. A line invalidated by the
+  // snooper must be reported with classifier_->invalidated(), so that its
+  // next miss counts as a coherence miss.
+  MissClassifier* classifier_;
+
+  // Statistics of this cache: accesses, latency per access from request to
+  // completion, and cycles spent waiting for the bus per miss
+  StatGroup&     stats_;
+  StatCounter&   readHits_;
+  StatCounter&   readMisses_;
+  StatCounter&   writeHits_;
+  StatCounter&   writeMisses_;
+  StatCounter&   staleReads_;
+  StatHistogram& latency_;
+  StatHistogram& busAcquire_;
+
+  // Cycle at which the current request was received
+  uint64_t reqCycle_;
+
+  // Line written back by the current miss
+  bool     writeback_;
+  uint32_t victim_;
+
+  /* Allocate the missing line and read it from memory, writing a dirty
+  replaced line back first. The timing does not follow this: it keeps the
+  cost model of the tutorial, a write miss in a full set pays for a
+  write-back and a read miss only for its fetch, whether the victim is
+  dirty or not. */
+  int allocate(int index, int tag) {
+    uint32_t replaced = 0;
+    bool dirty = false;
+    int way = core_.allocate(index, tag, &replaced, &dirty);
+    victim_    = core_.address(index, replaced);
+    writeback_ = dirty;
+    if (dirty) {
+      memory.write(victim_, core_.data(index, way), lineSize_);
     }
-    void shiftLinesHit(int linePosition) {
-      for(int i = 0; i < linePosition-1 ; i++) {
-        line[i+1] = line[i];
+    memory.read(core_.address(index, tag), core_.data(index, way), lineSize_);
+    return way;
+  }
+
+  /* Write a word of the CPU into its line. */
+  void store(int index, int way, int addr, int data) {
+    memcpy(core_.data(index, way) + (addr & (lineSize_ - 4)), &data, sizeof(data));
+    core_.set_dirty(index, way);
+    if (reference != NULL) {
+      reference->write_word(addr, data);
+    }
+  }
+
+  /* Count a read whose word differs from the last write to it. */
+  void checkRead(int index, int way, int addr) {
+    if (reference != NULL) {
+      uint32_t value;
+      memcpy(&value, core_.data(index, way) + (addr & (lineSize_ - 4)), sizeof(value));
+      if (value != reference->read_word(addr)) {
+        staleReads_++;
       }
     }
+  }
 
-    /* Reorder functions move around lines in a set, depending on whether it's a hit or miss.
-    The first position in a set is always occupied by the MRU line.*/
-    void reorderMiss(int numOfEntries, int tag, int data) {
-      if (numOfEntries == 1){
-        line[1] = line[0];
-      } else {
-        shiftLinesMiss(numOfEntries);
+  /* Append the bus transactions of the current miss to the bus trace: the
+  write-back of a dirty victim, if any, then the miss itself. */
+  void traceBus(Function f, int addr) {
+    if (bustrace != NULL) {
+      uint64_t cycle = current_cycle();
+      if (writeback_) {
+        bustrace->request(pid_, cycle, victim_, true);
       }
-      line[MRU_POSITION].tag = tag;
-      line[MRU_POSITION].data = data;
-      if (this->numOfEntries < NUM_LINES)
-      this->numOfEntries++;
+      bustrace->request(pid_, cycle, addr, f == F_WRITE);
     }
+  }
 
-    void reorderHit(int linePosition) {
-      if (linePosition == 0) {
-        ;
-      }  else if (linePosition == 1) {
-        swap(line[MRU_POSITION], line [linePosition]);
+  /* Count an access in the table of aca2009.h and in the registry. */
+  void countAccess(Function f, bool hit) {
+    if (f == F_READ) {
+      if (hit) {
+        stats_readhit(pid_);
+        readHits_++;
       } else {
-        Line temp = line[linePosition];
-        shiftLinesHit(linePosition);
-        line[MRU_POSITION] = temp;
+        stats_readmiss(pid_);
+        readMisses_++;
+      }
+    } else {
+      if (hit) {
+        stats_writehit(pid_);
+        writeHits_++;
+      } else {
+        stats_writemiss(pid_);
+        writeMisses_++;
       }
     }
-  };
+  }
 
-  // Custom constructor
-  Cache(sc_module_name nm, int pid): sc_module(nm), pid_(pid) {
+  /* Record the latency of the finished request, and append it to the event
+  log if there is one. */
+  void completeAccess(Function f, int addr, int index, bool hit, int way) {
+    HOST_PROFILE_SCOPE("cache.complete");
+    uint64_t latency = current_cycle() - reqCycle_;
+    latency_.sample(latency);
+    if (eventlog != NULL) {
+      EventRecord r;
+      r.time    = reqCycle_;
+      r.addr    = addr;
+      r.latency = latency;
+      r.set     = index;
+      r.cpu     = pid_;
+      r.way     = way;
+      r.flags   = (hit ? EVENT_HIT : 0) | (f == F_WRITE ? EVENT_WRITE : 0);
+      eventlog->append(r);
+    }
+  }
 
-    SC_THREAD(snoop);
-    SC_THREAD(execute);
-    sensitive << Port_CLK.pos();
-    // Perhaps dont_initialize() can be executed
-    //dont_initialize();
+  /* Retry for the bus next cycle, or once it is released when
+  fast-forwarding, see Bus::waitForBus(). */
+  void waitForBus() {
+#if defined(CACHE_USE_SC_METHOD) && defined(CACHE_FAST_FORWARD)
+    next_trigger(Port_Bus->released_event());
+#elif defined(CACHE_USE_SC_METHOD)
+    next_cycle(Port_CLK);
+#elif defined(CACHE_FAST_FORWARD)
+    wait(Port_Bus->released_event());
+#else
+    wait();
+#endif
   }
 
-private:
-  int pid_;
+#ifdef CACHE_USE_SC_METHOD
 
-  int getIndex (int address) {
-    return (address & 0x0000FE0) >> 5;
+  // States of the cache controller
+  enum State
+  {
+    ST_IDLE,        // waiting for a CPU request
+    ST_MEM_DELAY,   // memory access penalty has elapsed
+    ST_BUS_LOCK,    // polling for the bus, once per clock cycle
+    ST_BUS_XFER,    // bus transaction done, release it
+    ST_WRITE_DONE   // acknowledge a write one cycle later
+  };
+
+  State   state_;
+  sc_time memDelay_;  // memLatency_ cycles
+
+  // Request being served
+  Function f_;
+  int addr_;
+  int index_;
+  int tag_;
+  int data_;
+  bool hit_;
+  int way_;
+  uint64_t busStart_;
+
+  /* Allocate the line of the current request. */
+  void fill()
+  {
+    way_ = allocate(index_, tag_);
+    if (f_ == F_WRITE) {
+      store(index_, way_, addr_, data_);
+    }
   }
 
-  int getTag (int address) {
-    return (address & 0xFFFFF000) >> 12;
+  /* Method that handles the bus. */
+  void snoop()
+  {
+    HOST_PROFILE_SCOPE("cache.snoop");
+    switch(Port_BusFunction.read())
+    {
+      case F_READ:
+      break;
+      case F_WRITE:
+      break;
+      case F_INVALID:
+      break;
+    }
   }
 
+  /* Cache controller state machine, see the SC_THREAD version for the
+  timing it reproduces. Every call either returns to ST_IDLE, where the
+  static sensitivity to Port_CpuFunc applies, or sets its next trigger. */
+  void execute()
+  {
+    HOST_PROFILE_SCOPE("cache.execute");
+    switch(state_)
+    {
+      case ST_IDLE:
+      {
+        reqCycle_ = current_cycle();
+        f_     = Port_CpuFunc.read();
+        addr_  = Port_CpuAddr.read();
+        if (wavetracer != NULL) {
+          wavetracer->access(addr_);
+        }
+        if (intervals != NULL) {
+          intervals->access(addr_, reqCycle_);
+        }
+        index_ = core_.index(addr_);
+        tag_   = core_.tag(addr_);
+        data_  = 0;
+
+        int numOfEntries = core_.entries(index_);
+        way_ = core_.find(index_, tag_);
+        hit_ = way_ > -1;
+        if (classifier_ != NULL) {
+          classifier_->access(addr_, hit_);
+        }
+
+        Port_Index.write(index_);
+        Port_Tag.write(tag_);
+        Port_NumOfEntries.write(numOfEntries);
+
+        if (f_ == F_WRITE) {
+          data_ = Port_CpuData.read().to_int();
+          Port_ReadWrite.write(false);
+        } else {
+          Port_ReadWrite.write(true);
+        }
+
+        if (hit_) {
+          core_.touch(index_, way_);
+          if (f_ == F_WRITE) {
+            store(index_, way_, addr_, data_);
+          }
+          Port_HitMiss.write(true);
+          if (f_ == F_READ) {
+            countAccess(F_READ, true);
+            checkRead(index_, way_, addr_);
+            completeAccess(f_, addr_, index_, hit_, way_);
+            Port_CpuDone.write( RET_READ_DONE );
+          } else {
+            countAccess(F_WRITE, true);
+            state_ = ST_WRITE_DONE;
+            next_cycle(Port_CLK);
+          }
+        }
+        else if (f_ == F_READ || numOfEntries == (int) core_.num_ways()) {
+          // simulate memory access penalty, or the writeback of a full set
+          state_ = ST_MEM_DELAY;
+          next_trigger(memDelay_);
+        }
+        else {
+          fill();
+          busStart_ = current_cycle();
+          state_ = ST_BUS_LOCK;
+          execute();
+        }
+        break;
+      }
+
+      case ST_MEM_DELAY:
+        fill();
+        busStart_ = current_cycle();
+        state_ = ST_BUS_LOCK;
+        execute();
+        break;
+
+      case ST_BUS_LOCK:
+        if (testMtx.trylock() == -1) {
+          waitForBus();
+        }
+        else if (!Port_Bus->request(pid_, addr_, f_)) {
+          testMtx.unlock();
+          waitForBus();
+        }
+        else {
+          busAcquire_.sample(current_cycle() - busStart_);
+          traceBus(f_, addr_);
+          state_ = ST_BUS_XFER;
+          next_cycle(Port_CLK, busCycles_);
+        }
+        break;
+
+      case ST_BUS_XFER:
+        Port_Bus->release();
+        testMtx.unlock();
+        Port_HitMiss.write(false);
+        if (f_ == F_READ) {
+          countAccess(F_READ, false);
+          checkRead(index_, way_, addr_);
+          completeAccess(f_, addr_, index_, hit_, way_);
+          Port_CpuDone.write( RET_READ_DONE );
+          state_ = ST_IDLE;
+        } else {
+          countAccess(F_WRITE, false);
+          state_ = ST_WRITE_DONE;
+          next_cycle(Port_CLK);
+        }
+        break;
+
+      case ST_WRITE_DONE:
+        completeAccess(f_, addr_, index_, hit_, way_);
+        Port_CpuDone.write( RET_WRITE_DONE );
+        state_ = ST_IDLE;
+        break;
+    }
+  }
 
+#else
 
   /* Thread that handles the bus. */
   void snoop()
   {
-    logger << "[Cache" << pid_ << "][bus] start" << endl;
+    LOG_DEBUG("[Cache" << pid_ << "][bus] start");
 
     // get index and line position from address
 
@@ -303,7 +759,8 @@ private:
     {
       /* Wait for work. */
       wait(Port_BusFunction.value_changed_event());
-      logger << "[Cache" << pid_ << "][bus] noticed an event" << endl;
+      HOST_PROFILE_SCOPE("cache.snoop");
+      LOG_TRACE("[Cache" << pid_ << "][bus] noticed an event");
 
       /* Possibilities. */
       // if (set[index].line[linePosition].isValid) {
@@ -330,31 +787,33 @@ private:
   void execute()
   {
     //logger << "[Cache" << pid_ << "][execute] " << "start" << endl;
-    // Build an array of sets, where each set is an array of lines.
-
-    Set set[NUM_SETS];
-    for (int i=0 ; i<NUM_SETS ; i++){
-      for (int j=0 ; j<NUM_LINES ; j++){
-        Line newLine;
-        set[i].line[j] = newLine;
-      }
-    }
 
     while (true)
     {
       wait(Port_CpuFunc.value_changed_event());	// this is fine since we use sc_buffer
 
+      reqCycle_  = current_cycle();
       Function f = Port_CpuFunc.read();
       int addr   = Port_CpuAddr.read();
-      int index  = getIndex(addr);
-      int tag    = getTag(addr);
+      int index  = core_.index(addr);
+      int tag    = core_.tag(addr);
       int data   = 0;
+      if (wavetracer != NULL) {
+        wavetracer->access(addr);
+      }
+      if (intervals != NULL) {
+        intervals->access(addr, reqCycle_);
+      }
 
       //cout << "Index: " << index << "   Tag: " << tag << endl;
       //logger << "Index: " << index << "   Tag: " << tag << endl;
 
-      int linePosition = set[index].findTag(tag);
-      int numOfEntries = set[index].numOfEntries;
+      int way          = core_.find(index, tag);
+      int numOfEntries = core_.entries(index);
+      bool hit         = way > -1;
+      if (classifier_ != NULL) {
+        classifier_->access(addr, hit);
+      }
 
       Port_Index.write(index);
       Port_Tag.write(tag);
@@ -379,75 +838,79 @@ private:
 
       if (f == F_READ)
       {
-        if (linePosition > -1) {
-          set[index].reorderHit(linePosition);
+        if (hit) {
+          core_.touch(index, way);
           // leave the bus alone
           //cout << "READ HIT" << endl;
           //  logger << "READ HIT" << endl;
-          stats_readhit(pid_);
+          countAccess(F_READ, true);
           Port_HitMiss.write(true);
-          hitRate++;
         }
         else {
-          wait(100); // simulate memory access penalty
-          set[index].reorderMiss(numOfEntries, tag, data);
+          wait_cycles(memLatency_); // simulate memory access penalty
+          way = allocate(index, tag);
           // take the data from the bus
+          uint64_t busStart = current_cycle();
           while(testMtx.trylock() == -1)
           {
-            wait();
+            waitForBus();
           }
+          busAcquire_.sample(current_cycle() - busStart);
+          traceBus(f, addr);
           Port_Bus->read(pid_, addr);
           testMtx.unlock();
           //cout << "READ MISS" << endl;
           //  logger << "READ MISS" << endl;
-          stats_readmiss(pid_);
+          countAccess(F_READ, false);
           Port_HitMiss.write(false);
-          missRate++;
         }
 
+        checkRead(index, way, addr);
+        completeAccess(f, addr, index, hit, way);
         Port_CpuDone.write( RET_READ_DONE );
 
       }
       else //writing
       {
-        if (linePosition > -1) {
-          set[index].reorderHit(linePosition);
+        if (hit) {
+          core_.touch(index, way);
+          store(index, way, addr, data);
           //cout << "WRITE HIT" << endl;
           //logger << "WRITE HIT" << endl;
-          stats_writehit(pid_);
+          countAccess(F_WRITE, true);
           Port_HitMiss.write(true);
-          hitRate++;
         }
         else {
-          if (numOfEntries == NUM_LINES) {
-            wait(100); // set is full => writeback
+          if (numOfEntries == (int) core_.num_ways()) {
+            wait_cycles(memLatency_); // set is full => writeback
           }
-          set[index].reorderMiss(numOfEntries, tag, data);
+          way = allocate(index, tag);
+          store(index, way, addr, data);
+          uint64_t busStart = current_cycle();
           while(testMtx.trylock() == -1)
           {
-            wait();
+            waitForBus();
           }
+          busAcquire_.sample(current_cycle() - busStart);
+          traceBus(f, addr);
           Port_Bus->write(pid_, addr, data);
           testMtx.unlock();
           //cout << "WRITE MISS" << endl;
           //logger << "WRITE MISS" << endl;
           //Port_Bus.write(F_WRITE);
           //Port_Bus->read(pid_, addr);
-          stats_writemiss(pid_);
+          countAccess(F_WRITE, false);
           Port_HitMiss.write(false);
-          missRate++;
         }
-        wait();
+        wait_cycles();
+        completeAccess(f, addr, index, hit, way);
         Port_CpuDone.write( RET_WRITE_DONE );
       }
 
-      for (int i=0 ; i<NUM_LINES ; i++) {
-        //cout << "Line : " << i << "   Tag: " << set[index].line[i].tag << endl;
-        //logger << "Line : " << i << "   Tag: " << set[index].line[i].tag << endl;
-      }
-
     }
   }
+
+#endif
 };
 
 
@@ -469,24 +932,237 @@ public:
   SC_HAS_PROCESS(CPU);
 
   // Custom constructor
-  CPU(sc_module_name name, int pid) : sc_module(name), pid_(pid)
+  CPU(sc_module_name name, int pid) : sc_module(name), pid_(pid), cache_(NULL)
   {
     iNumber_ = 0;
+    isDone_ = false;
+#ifdef CACHE_USE_SC_METHOD
+    state_ = ST_FETCH;
+    SC_METHOD(execute);
+#else
     SC_THREAD(execute);
     sensitive << Port_CLK.pos();
+#endif
+  }
+
+
+  /* Cache to warm functionally between sampling windows. */
+  void setCache(Cache* cache)
+  {
+    cache_ = cache;
+  }
+
+  /* Write or restore the number of trace entries fetched. */
+  void save(CheckpointWriter& out) const
+  {
+    out.section("CPU ");
+    out.put(iNumber_);
   }
 
+  void load(CheckpointReader& in)
+  {
+    in.section("CPU ");
+    in.get(iNumber_);
+  }
 
 private:
   int pid_;
   int iNumber_;
   bool isDone_;
+  Cache* cache_;
 
+  /* Check for the checkpoint before fetching. A CPU that has fetched the
+  checkpoint's entries stops there, so its cache is idle; the last one to
+  arrive saves the checkpoint and stops the simulation. */
+  bool reachCheckpoint()
+  {
+    if(checkpointFile == NULL || (uint64_t) iNumber_ != checkpointAt)
+    {
+      return false;
+    }
+    if(++numProcessesAtCheckpoint == gNumProcesses)
+    {
+      save_checkpoint();
+      sc_stop();
+    }
+    return true;
+  }
+
+  /* Get the next trace entry to simulate. When sampling, the entries
+  between the measured windows are handed straight to the cache, so this
+  returns the next entry of a window, or a NOP once the trace has ended. */
+  bool fetch(TraceFile::Entry& tr_data)
+  {
+    HOST_PROFILE_SCOPE("cpu.fetch");
+    iNumber_++;
+    bool ended = tracefile_ptr->finished(pid_);
+    if(!tracefile_ptr->next(pid_, tr_data))
+    {
+      return false;
+    }
+
+    while(sampler != NULL && !ended && !sampler->step(pid_, current_cycle()))
+    {
+      if(tr_data.type != TraceFile::ENTRY_TYPE_NOP)
+      {
+        cache_->warm(tr_data.type == TraceFile::ENTRY_TYPE_READ ? F_READ : F_WRITE, tr_data.addr);
+      }
+      if(checkpointFile != NULL && (uint64_t) iNumber_ == checkpointAt)
+      {
+        // Stop warming, the next fetch reaches the checkpoint
+        tr_data.type = TraceFile::ENTRY_TYPE_NOP;
+        break;
+      }
+
+      iNumber_++;
+      ended = tracefile_ptr->finished(pid_);
+      if(ended)
+      {
+        // Idle from here on, in detail
+        tr_data.type = TraceFile::ENTRY_TYPE_NOP;
+        break;
+      }
+      if(!tracefile_ptr->next(pid_, tr_data))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* Count this CPU as done and stop the simulation after the last one. A
+  CPU that ends its trace before the checkpoint stops the run at once, as
+  the others would wait for it there. */
+  void finish()
+  {
+    if( !isDone_ && checkpointFile != NULL && (uint64_t) iNumber_ < checkpointAt )
+    {
+      cerr << "Error, CPU " << pid_ << " ended its trace after " << iNumber_
+           << " entries, before the checkpoint at " << checkpointAt
+           << "; no checkpoint saved" << endl;
+      checkpointMissed = true;
+      sc_stop();
+    }
+    if( !isDone_ )
+    {
+      doneProcessesMtx.lock();
+      numProcessesDone++;
+      doneProcessesMtx.unlock();
+      isDone_ = true;
+    }
+    if(numProcessesDone == gNumProcesses)
+    {
+      sc_stop();
+      LOG_INFO("Simulation stopped");
+      cout << "Total runtime: " << sc_time_stamp() << endl;
+    }
+  }
+
+#ifdef CACHE_USE_SC_METHOD
+
+  // States of the CPU
+  enum State
+  {
+    ST_FETCH,       // issue the next trace entry
+    ST_WRITE_DATA,  // write data has been driven for a cycle
+    ST_WAIT_DONE    // waiting for the cache to acknowledge
+  };
+
+  State    state_;
+  Function f_;
+
+  /* CPU state machine. The method has no static sensitivity, it is only
+  triggered through next_trigger() and stops once the tracefile ends. */
   void execute()
   {
-    //logger << "[CPU" << pid_ << "][execute] " << "start" << endl;
+    HOST_PROFILE_SCOPE("cpu.execute");
+    TraceFile::Entry tr_data;
+
+    switch(state_)
+    {
+      case ST_FETCH:
+        if(tracefile_ptr->eof())
+        {
+          finish();
+          return;
+        }
+        if(reachCheckpoint())
+        {
+          return;
+        }
+
+        // Get the next action for the processor in the trace
+        if(!fetch(tr_data))
+        {
+          cerr << "Error reading trace for CPU" << endl;
+          finish();
+          return;
+        }
+
+        switch(tr_data.type)
+        {
+          case TraceFile::ENTRY_TYPE_READ:
+          f_ = F_READ;
+          break;
+
+          case TraceFile::ENTRY_TYPE_WRITE:
+          f_ = F_WRITE;
+          break;
+
+          case TraceFile::ENTRY_TYPE_NOP:
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] executes NOP");
+          // Advance one cycle in simulated time
+          next_cycle(Port_CLK);
+          return;
+
+          default:
+          cerr << "Error, got invalid data from Trace" << endl;
+          exit(0);
+        }
+
+        Port_CacheAddr.write(tr_data.addr);
+        Port_CacheFunc.write(f_);
+
+        if (f_ == F_WRITE)
+        {
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] sends write");
+
+          uint32_t data = rand();
+          Port_CacheData.write(data);
+          state_ = ST_WRITE_DATA;
+          next_cycle(Port_CLK);
+        }
+        else
+        {
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] sends read");
+          state_ = ST_WAIT_DONE;
+          next_trigger(Port_CacheDone.value_changed_event());
+        }
+        break;
+
+      case ST_WRITE_DATA:
+        state_ = ST_WAIT_DONE;
+        next_trigger(Port_CacheDone.value_changed_event());
+        break;
+
+      case ST_WAIT_DONE:
+        if (f_ == F_READ)
+        {
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] reads: " << Port_CacheData.read());
+        }
+
+        // Advance one cycle in simulated time
+        state_ = ST_FETCH;
+        next_cycle(Port_CLK);
+        break;
+    }
+  }
 
-    bool isDone_ = false;
+#else
+
+  void execute()
+  {
+    //logger << "[CPU" << pid_ << "][execute] " << "start" << endl;
 
     TraceFile::Entry    tr_data;
     Function  f;
@@ -501,12 +1177,16 @@ private:
 
     while(!endOfFile)
     {
+      if(reachCheckpoint())
+      {
+        return;
+      }
+
       // Get the next action for the processor in the trace
       traceFileMtx.lock();
-      gotNext   = tracefile_ptr->next(pid_, tr_data);
+      gotNext   = fetch(tr_data);
       traceFileMtx.unlock();
       //logger << "[CPU" << pid_ << "][execute] " << "read instruction #" << iNumber_ << endl;
-      iNumber_++;
       if(!gotNext)
       {
         cerr << "Error reading trace for CPU" << endl;
@@ -540,16 +1220,16 @@ private:
 
         if (f == F_WRITE)
         {
-          cout << sc_time_stamp() << ": [CPU" << pid_ << "] sends write" << endl;
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] sends write");
 
           uint32_t data = rand();
           Port_CacheData.write(data);
-          wait();
+          wait_cycles();
 
         }
         else
         {
-          cout << sc_time_stamp() << ": [CPU" << pid_ << "] sends read" << endl;
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] sends read");
         }
 
         // cout << "waiting" << endl;
@@ -558,46 +1238,35 @@ private:
 
         if (f == F_READ)
         {
-          cout << sc_time_stamp() << ": [CPU" << pid_ << "] reads: " << Port_CacheData.read() << endl;
+          LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] reads: " << Port_CacheData.read());
         }
       }
       else
       {
-        cout << sc_time_stamp() << ": [CPU" << pid_ << "] executes NOP" << endl;
+        LOG_TRACE(sc_time_stamp() << ": [CPU" << pid_ << "] executes NOP");
       }
 
       // chceck if end of file
       endOfFile = tracefile_ptr->eof();
 
       // Advance one cycle in simulated time
-      wait();
-      cout << endl;
-    }
-
-    if( !isDone_ )
-    {
-      doneProcessesMtx.lock();
-      numProcessesDone++;
-      doneProcessesMtx.unlock();
-      isDone_ = true;
-    }
-    if(numProcessesDone == gNumProcesses)
-    {
-      sc_stop();
-      logger << "Simulation stopped" << endl;
-      cout << "Total runtime: " << sc_time_stamp() << endl;
+      wait_cycles();
     }
 
+    finish();
   }
+
+#endif
 };
 
+/* A CPU and its private cache. Both are members, so their modules are
+named <unit>.cpu and <unit>.cache. The units are placed one after another
+in a block set aside by reserve(), so a sweep over all of them walks
+contiguous memory instead of one heap allocation per unit. */
 class ProcessingUnit : public sc_module
 {
 public:
 
-  CPU *cpu;
-  Cache *cache;
-
   // Clock
   sc_in<bool>       Port_CLK;
 
@@ -607,50 +1276,116 @@ public:
   sc_signal<int>      sigCpuAddr;
   sc_signal_rv<32>    sigCpuData;
 
+  CPU   cpu;
+  Cache cache;
+
   // has to be added when no standard constructor SC_CTOR is used
   SC_HAS_PROCESS(ProcessingUnit);
 
   // Custom constructor
-  ProcessingUnit(sc_module_name name, int pid) : sc_module(name), pid_(pid)
+  ProcessingUnit(sc_module_name name, int pid, const SystemConfig& config)
+  : sc_module(name), cpu("cpu", pid), cache("cache", pid, config), pid_(pid)
   {
-    // Create and patch CPU
-    cpu = new CPU("cpu", pid_);
-
-    cpu->Port_CacheFunc(sigCpuFunc);
-    cpu->Port_CacheAddr(sigCpuAddr);
-    cpu->Port_CacheData(sigCpuData);
-    cpu->Port_CacheDone(sigCpuDone);
-    cpu->Port_CLK(Port_CLK);
-    logger << "[PU" << pid_ << "] cpu created" << endl;
-
-    // Create and patch Cache
-    cache = new Cache("cache", pid_);
-
-    cache->Port_CpuFunc(sigCpuFunc);
-    cache->Port_CpuAddr(sigCpuAddr);
-    cache->Port_CpuData(sigCpuData);
-    cache->Port_CpuDone(sigCpuDone);
-    //    cache->Port_BusFunc(sigBusFunc);
-    cache->Port_CLK(Port_CLK);
+    // Patch CPU
+    cpu.Port_CacheFunc(sigCpuFunc);
+    cpu.Port_CacheAddr(sigCpuAddr);
+    cpu.Port_CacheData(sigCpuData);
+    cpu.Port_CacheDone(sigCpuDone);
+    cpu.Port_CLK(Port_CLK);
+    LOG_DEBUG("[PU" << pid_ << "] cpu created");
+
+    // Patch Cache
+    cpu.setCache(&cache);
+
+    cache.Port_CpuFunc(sigCpuFunc);
+    cache.Port_CpuAddr(sigCpuAddr);
+    cache.Port_CpuData(sigCpuData);
+    cache.Port_CpuDone(sigCpuDone);
+    cache.Port_CLK(Port_CLK);
     // signals for output trace
-    cache->Port_Index(sigIndex);
-    cache->Port_Tag(sigTag);
-    cache->Port_NumOfEntries(sigNumOfEntries);
-    cache->Port_ReadWrite(sigReadWrite);
-    cache->Port_HitMiss(sigHitMiss);
-    logger << "[PU" << pid_ << "] cache created" << endl;
+    cache.Port_Index(sigIndex);
+    cache.Port_Tag(sigTag);
+    cache.Port_NumOfEntries(sigNumOfEntries);
+    cache.Port_ReadWrite(sigReadWrite);
+    cache.Port_HitMiss(sigHitMiss);
+    LOG_DEBUG("[PU" << pid_ << "] cache created");
+
+    // Runs once at initialization, nothing to do per cycle. A method
+    // needs no coroutine stack, which adds up over hundreds of units.
+    SC_METHOD(execute);
+    LOG_DEBUG("[PU" << pid_ << "] method registered");
+  }
 
+  /* Set aside room for count units. The sc_vector creates its units with
+  new and deletes them one by one, so the block is handed out here and
+  released with its last unit; units past count come from the heap. */
+  static void reserve(size_t count) {
+    pool_     = (char*) ::operator new(count * sizeof(ProcessingUnit));
+    poolSize_ = count;
+    poolUsed_ = 0;
+    poolLive_ = 0;
+  }
 
-    SC_THREAD(execute);
-    logger << "[PU" << pid_ << "] thread registered" << endl;
-    sensitive << Port_CLK.pos();
-    // perhaps dont_initialize() can be executed
-    //dont_initialize();
+  static void* operator new(size_t size) {
+    if (size != sizeof(ProcessingUnit) || poolUsed_ == poolSize_)
+      return ::operator new(size);
+    poolLive_++;
+    return pool_ + sizeof(ProcessingUnit) * poolUsed_++;
+  }
+
+  static void operator delete(void* p) {
+    char* unit = (char*) p;
+    if (pool_ == NULL || unit < pool_ || unit >= pool_ + sizeof(ProcessingUnit) * poolSize_) {
+      ::operator delete(p);
+    }
+    else if (--poolLive_ == 0) {
+      ::operator delete(pool_);
+      pool_     = NULL;
+      poolSize_ = 0;
+      poolUsed_ = 0;
+    }
+  }
+
+  /* Connect the unit to the clock, and its cache to the bus. */
+  void bind(sc_signal_in_if<bool>& clk, Bus& bus, sc_signal<int>& busWriter,
+            sc_signal<Function>& busFunction) {
+    Port_CLK(clk);
+    cache.Port_BusAddr(bus.Port_BusAddr);
+    cache.Port_BusWriter(busWriter);
+    cache.Port_BusFunction(busFunction);
+    cache.Port_Bus(bus);
+  }
+
+  /* Write or restore the state of the CPU and the cache. */
+  void save(CheckpointWriter& out) const {
+    cpu.save(out);
+    cache.save(out);
+  }
+
+  void load(CheckpointReader& in) {
+    cpu.load(in);
+    cache.load(in);
+  }
+
+  /* Register the signals of this unit with the waveform tracer. */
+  void trace(WindowTracer& tracer) {
+    char prefix[32];
+    sprintf(prefix, "pu%d.", pid_);
+    tracer.trace(sigIndex, string(prefix) + "Index", 32);
+    tracer.trace(sigTag, string(prefix) + "Tag", 32);
+    tracer.trace(sigNumOfEntries, string(prefix) + "NumOfEntries", 32);
+    tracer.trace(sigReadWrite, string(prefix) + "ReadWrite", 1);
+    tracer.trace(sigHitMiss, string(prefix) + "HitMiss", 1);
   }
 
 private:
   int pid_;
 
+  // Block of reserve(), units handed out and units not yet deleted
+  static char*  pool_;
+  static size_t poolSize_;
+  static size_t poolUsed_;
+  static size_t poolLive_;
 
   sc_signal<int>        sigIndex;
   sc_signal<int>        sigTag;
@@ -660,11 +1395,219 @@ private:
 
   void execute()
   {
-    logger << "[PU" << pid_ << "] [execute] " << "start" << endl;
+    LOG_DEBUG("[PU" << pid_ << "] [execute] " << "start");
 
   }
 };
 
+char*  ProcessingUnit::pool_     = NULL;
+size_t ProcessingUnit::poolSize_ = 0;
+size_t ProcessingUnit::poolUsed_ = 0;
+size_t ProcessingUnit::poolLive_ = 0;
+
+/* Creates the processing units of an sc_vector, pu_0, pu_1, ..., in the
+block of ProcessingUnit::reserve(), and binds each to the clock and the
+bus as it is created, so elaboration makes a single pass over the units. */
+class ProcessingUnitCreator
+{
+public:
+  ProcessingUnitCreator(const SystemConfig& config, sc_signal_in_if<bool>& clk, Bus& bus,
+                        sc_signal<int>& busWriter, sc_signal<Function>& busFunction)
+  : config_(config), clk_(clk), bus_(bus), busWriter_(busWriter), busFunction_(busFunction) {
+  }
+
+  ProcessingUnit* operator()(const char* name, size_t pid) {
+    ProcessingUnit* unit = new ProcessingUnit(name, pid, config_);
+    unit->bind(clk_, bus_, busWriter_, busFunction_);
+    return unit;
+  }
+
+private:
+  const SystemConfig&    config_;
+  sc_signal_in_if<bool>& clk_;
+  Bus&                   bus_;
+  sc_signal<int>&        busWriter_;
+  sc_signal<Function>&   busFunction_;
+};
+
+/* Calls a function every interval cycles. */
+class Periodic : public sc_module
+{
+public:
+  SC_HAS_PROCESS(Periodic);
+
+  Periodic(sc_module_name name, uint64_t interval, void (*call)())
+  : sc_module(name), interval_(interval * clockPeriod), call_(call) {
+    SC_METHOD(tick);
+  }
+
+private:
+  sc_time interval_;
+  void (*call_)();
+
+  void tick() {
+    // The first call is the initialization at time 0
+    if (sc_time_stamp() > SC_ZERO_TIME) {
+      call_();
+    }
+    next_trigger(interval_);
+  }
+};
+
+void take_snapshot()
+{
+  statistics.snapshot(current_cycle());
+}
+
+void end_interval()
+{
+  intervals->interval(current_cycle());
+}
+
+/* Export the statistics registry. */
+void write_statistics(const char* jsonFile, const char* csvFile)
+{
+  const char* files[2] = { jsonFile, csvFile };
+  for(int i = 0; i < 2; i++)
+  {
+    if(files[i] == NULL)
+    {
+      continue;
+    }
+    FILE* f = fopen(files[i], "w");
+    if(f == NULL)
+    {
+      throw runtime_error(string("Unable to create file: ") + files[i]);
+    }
+    if(i == 0)
+    {
+      statistics.write_json(f, current_cycle());
+    }
+    else
+    {
+      statistics.write_csv(f, current_cycle());
+    }
+    fclose(f);
+  }
+}
+
+// Modules covered by a checkpoint
+sc_vector<ProcessingUnit>* checkpointUnits = NULL;
+
+/* Write the simulator state: cycle, trace cursors, statistics, and the
+CPUs and caches. */
+void save_checkpoint()
+{
+  CheckpointWriter out(checkpointFile);
+
+  out.section("SIM ");
+  out.put((uint32_t) gNumProcesses);
+  out.put(current_cycle());
+
+  out.section("TRCE");
+  out.put_vector(tracefile_ptr->get_positions());
+
+  out.section("STAT");
+  for(int i = 0; i < gNumProcesses; i++)
+  {
+    int counters[4];
+    stats_get(i, counters);
+    out.put(counters);
+  }
+
+  statistics.save(out);
+  for(int i = 0; i < gNumProcesses; i++)
+  {
+    (*checkpointUnits)[i].save(out);
+  }
+  memory.save(out);
+
+  out.section("REFM");
+  out.put(reference != NULL);
+  if(reference != NULL)
+  {
+    reference->save(out);
+  }
+  out.close();
+
+  cout << "Checkpoint saved at cycle " << current_cycle() << ": " << checkpointFile << endl;
+}
+
+/* Restore a checkpoint before the simulation starts. Simulated time starts
+again from 0. */
+void load_checkpoint(const char* filename, sc_vector<ProcessingUnit>& units)
+{
+  CheckpointReader in(filename);
+
+  in.section("SIM ");
+  if(in.get<uint32_t>() != (uint32_t) gNumProcesses)
+  {
+    in.fail("different number of processors");
+  }
+  uint64_t cycle = in.get<uint64_t>();
+
+  in.section("TRCE");
+  vector<uint64_t> positions;
+  in.get_vector(positions, gNumProcesses);
+  tracefile_ptr->set_positions(positions);
+
+  in.section("STAT");
+  for(int i = 0; i < gNumProcesses; i++)
+  {
+    int counters[4];
+    in.get(counters);
+    stats_set(i, counters);
+  }
+
+  statistics.load(in);
+  for(int i = 0; i < gNumProcesses; i++)
+  {
+    units[i].load(in);
+  }
+  memory.load(in);
+
+  // The reference image is only known if the checkpointed run kept one
+  in.section("REFM");
+  if(in.get<bool>())
+  {
+    BackingStore discarded;
+    (reference != NULL ? *reference : discarded).load(in);
+  }
+  else if(reference != NULL)
+  {
+    in.fail("saved without --check-values");
+  }
+
+  cout << "Restored checkpoint taken at cycle " << cycle << ": " << filename << endl;
+}
+
+// Largest line data of one cache, in bytes
+static const uint64_t MAX_CACHE_DATA = 1ULL << 30;
+
+/* Read and check the system parameters. Everything is validated here,
+before elaboration, so a bad value fails the run at once. */
+SystemConfig read_config(Config& cfg)
+{
+  SystemConfig config;
+  config.sets          = cfg.get_uint("cache.sets", 128, 1, 1u << 24);
+  config.ways          = cfg.get_uint("cache.ways", 8, 1, 255);
+  config.lineSize      = cfg.get_uint("cache.line", 32, 4, 4096);
+  config.policy        = parse_policy(cfg.get_string("cache.policy", "lru"));
+  config.memLatency    = cfg.get_uint("memory.latency", 100, 1, 1000000);
+  config.busCycles     = cfg.get_uint("bus.cycles", 1, 1, 1000);
+  config.clockPeriodNs = cfg.get_double("clock.period_ns", 1.0, 1e-3, 1e6);
+  cfg.check_unused();
+
+  // The cache model checks the geometry and policy. Every cache holds the
+  // data of its lines, so their size is bounded as well.
+  CacheCore::validate(config.sets, config.ways, config.lineSize, config.policy);
+  if((uint64_t) config.sets * config.ways * config.lineSize > MAX_CACHE_DATA)
+  {
+    throw runtime_error("cache.sets * cache.ways * cache.line must be at most 1 GiB");
+  }
+  return config;
+}
+
 int sc_main(int argc, char* argv[])
 {
 
@@ -672,35 +1615,212 @@ int sc_main(int argc, char* argv[])
   int num_procs = -1;
 
 
+  log_open(LOG_FILE);
+
   try
   {
-    logger << "[main] start" << endl;
+    LOG_DEBUG("[main] start");
 
     // Get the tracefile argument and create Tracefile object
     // This function sets tracefile_ptr and num_cpus
     init_tracefile(&argc, &argv);
-    logger << "[main] " << "tracefile inited" << endl;
+    LOG_DEBUG("[main] " << "tracefile inited");
 
     // Initialize statistics counters
     stats_init();
-    logger << "[main] " << "stats inited" << endl;
+    LOG_DEBUG("[main] " << "stats inited");
+
+    // Options following the tracefile
+    const char* waveFile = NULL;
+    vector<pair<uint64_t, uint64_t> > waveWindows;
+    uint32_t waveTriggerAddr = 0;
+    uint64_t waveTriggerLength = 0;
+    unsigned long long samplePeriod = 0, sampleWindow = 0, sampleWarmup = 0;
+    const char* restoreFile = NULL;
+    const char* statsJson = NULL;
+    const char* statsCsv = NULL;
+    unsigned long long statsInterval = 0;
+    const char* intervalFile = NULL;
+    const char* busTraceFile = NULL;
+    unsigned long long intervalCycles = 0, intervalAccesses = 0;
+    double phaseThreshold = 0.5;
+    string checkpointArg;
+    vector<const char*> configFiles;
+    vector<string> assignments;
+    const char* configSave = NULL;
+    for(int i = 0; i < argc && argv[i] != NULL; i++)
+    {
+      string opt = argv[i];
+      const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+      unsigned long long a, b;
+      long long addr;
+      int n;
+      if(opt == "--config" && value != NULL)
+      {
+        configFiles.push_back(value);
+        i++;
+      }
+      else if(opt == "--set" && value != NULL)
+      {
+        assignments.push_back(value);
+        i++;
+      }
+      else if(opt == "--config-save" && value != NULL)
+      {
+        configSave = value;
+        i++;
+      }
+      else if(opt == "--eventlog" && value != NULL)
+      {
+        eventlog = new EventLogWriter(value);
+        i++;
+      }
+      else if(opt == "--wavetrace" && value != NULL)
+      {
+        waveFile = value;
+        i++;
+      }
+      else if(opt == "--wave-window" && value != NULL && sscanf(value, "%llu:%llu", &a, &b) == 2 && b > a)
+      {
+        waveWindows.push_back(make_pair((uint64_t) a, (uint64_t) b));
+        i++;
+      }
+      else if(opt == "--wave-trigger" && value != NULL && sscanf(value, "%lli:%llu", &addr, &b) == 2 && b > 0)
+      {
+        waveTriggerAddr = addr;
+        waveTriggerLength = b;
+        i++;
+      }
+      else if(opt == "--checkpoint-save" && value != NULL && strrchr(value, ':') != NULL &&
+              sscanf(strrchr(value, ':') + 1, "%llu", &a) == 1 && a > 0)
+      {
+        checkpointArg = string(value, strrchr(value, ':') - value);
+        checkpointAt = a;
+        i++;
+      }
+      else if(opt == "--stats-json" && value != NULL)
+      {
+        statsJson = value;
+        i++;
+      }
+      else if(opt == "--stats-csv" && value != NULL)
+      {
+        statsCsv = value;
+        i++;
+      }
+      else if(opt == "--stats-interval" && value != NULL && sscanf(value, "%llu", &statsInterval) == 1)
+      {
+        i++;
+      }
+      else if(opt == "--bus-trace" && value != NULL)
+      {
+        busTraceFile = value;
+        i++;
+      }
+      else if(opt == "--intervals" && value != NULL)
+      {
+        intervalFile = value;
+        i++;
+      }
+      else if(opt == "--interval-cycles" && value != NULL && sscanf(value, "%llu", &intervalCycles) == 1)
+      {
+        i++;
+      }
+      else if(opt == "--interval-accesses" && value != NULL && sscanf(value, "%llu", &intervalAccesses) == 1)
+      {
+        i++;
+      }
+      else if(opt == "--phase-threshold" && value != NULL && sscanf(value, "%lf", &phaseThreshold) == 1)
+      {
+        i++;
+      }
+      else if(opt == "--classify")
+      {
+        classifyMisses = true;
+      }
+      else if(opt == "--check-values")
+      {
+        reference = new BackingStore();
+      }
+      else if(opt == "--checkpoint-restore" && value != NULL)
+      {
+        restoreFile = value;
+        i++;
+      }
+      else if(opt == "--sample" && value != NULL &&
+              (n = sscanf(value, "%llu:%llu:%llu", &samplePeriod, &sampleWindow, &sampleWarmup)) >= 2)
+      {
+        if(n == 2)
+        {
+          sampleWarmup = 0;
+        }
+        i++;
+      }
+      else
+      {
+        throw runtime_error("Unknown option: " + opt);
+      }
+    }
+
+    // Files first, in order, then the assignments of the command line
+    Config cfg;
+    for(size_t i = 0; i < configFiles.size(); i++)
+    {
+      cfg.load(configFiles[i]);
+    }
+    for(size_t i = 0; i < assignments.size(); i++)
+    {
+      cfg.set(assignments[i]);
+    }
+    const SystemConfig config = read_config(cfg);
+    clockPeriod = sc_time(config.clockPeriodNs, SC_NS);
+    if(eventlog != NULL && (config.sets > 65536 || config.ways > 128))
+    {
+      // The event log stores sets as uint16_t and ways as int8_t
+      throw runtime_error("--eventlog supports at most 65536 sets and 128 ways");
+    }
+    if(configSave != NULL)
+    {
+      FILE* f = fopen(configSave, "w");
+      if(f == NULL)
+      {
+        throw runtime_error(string("Unable to create file: ") + configSave);
+      }
+      cfg.write(f);
+      fclose(f);
+    }
 
     num_procs = tracefile_ptr->get_proc_count();
     gNumProcesses = num_procs;
 
-    // The clock that will drive the PU's, CPU and Cache
-    sc_clock clk;
+    if(busTraceFile != NULL)
+    {
+      bustrace = new BusTraceWriter(busTraceFile, num_procs);
+    }
+
+    if(samplePeriod > 0)
+    {
+      sampler = new Sampler(num_procs, samplePeriod, sampleWindow, sampleWarmup);
+    }
+
+    // The clock that will drive the PU's, CPU and Cache. When fast-forwarding
+    // nothing waits for its edges, so it is gated off and stays low.
+#ifdef CACHE_FAST_FORWARD
+    sc_signal<bool> clk("clk");
+#else
+    sc_clock clk("clk", clockPeriod);
+#endif
 
 
-    logger << "[main] " << "clock created" << endl;
-    logger << "[main] " << "num_proc: " << tracefile_ptr->get_proc_count() << endl;
+    LOG_DEBUG("[main] " << "clock created");
+    LOG_DEBUG("[main] " << "num_proc: " << tracefile_ptr->get_proc_count());
 
     // Create sc_buffer for connection between bus and caches
     sc_signal<int>        sigBusWriter;
     sc_signal<Function>   sigBusFunction;
 
     // Create Bus
-    Bus         bus("bus");
+    Bus         bus("bus", config);
     bus.Port_CLK(clk);
 
     // General Port_BusBus Signals
@@ -708,61 +1828,178 @@ int sc_main(int argc, char* argv[])
     bus.Port_BusFunction(sigBusFunction);
 
 
-    // Create a vector of pointers to processing units
-    std::vector<ProcessingUnit*> processingUnits;
+    // Create the processing units, connected to the clock and the bus
+    sc_vector<ProcessingUnit> processingUnits("pu");
+    ProcessingUnit::reserve(num_procs);
+    processingUnits.init(num_procs,
+                         ProcessingUnitCreator(config, clk, bus, sigBusWriter, sigBusFunction));
 
-    for( int i = 0; i < num_procs; i++ )
+    if(!checkpointArg.empty())
+    {
+      checkpointFile = checkpointArg.c_str();
+      checkpointUnits = &processingUnits;
+    }
+    if(restoreFile != NULL)
     {
-      // Create processing unit with given PID
-      ProcessingUnit* processingUnit = new ProcessingUnit("pu", i);
-      processingUnit->Port_CLK(clk);
-      // try to patch Caches that are in PUs
-      processingUnit->cache->Port_BusAddr(bus.Port_BusAddr);
-      processingUnit->cache->Port_BusWriter(sigBusWriter);
-      processingUnit->cache->Port_BusFunction(sigBusFunction);
-      processingUnit->cache->Port_Bus(bus);
-      // Push into vector
-      processingUnits.push_back(processingUnit);
+      load_checkpoint(restoreFile, processingUnits);
     }
 
-    logger << "[main] "  << "processingUnits created" << endl;
-    logger << "[main] "  << "processingUnits.size(): " << processingUnits.size() << endl;
+    LOG_DEBUG("[main] "  << "processingUnits created");
+    LOG_DEBUG("[main] "  << "processingUnits.size(): " << processingUnits.size());
 
-    logger << "[main] " << "Processing unit patched with clock" << endl;
+    LOG_DEBUG("[main] " << "Processing unit patched with clock");
 
-    // Open VCD file
-    // sc_trace_file *wf = sc_create_vcd_trace_file("cache_results");
-    // sc_trace(wf, clk, "Clock");
-    // sc_trace(wf, sigIndex, "Index");
-    // sc_trace(wf, sigTag, "Tag");
-    // sc_trace(wf, sigNumOfEntries, "NumOfEntries");
-    // sc_trace(wf, sigReadWrite, "Read/Write");
-    // sc_trace(wf, sigHitMiss, "Hit/Miss");
+    // Open the waveform trace. Without windows or a trigger the whole run
+    // is recorded.
+    if(waveFile != NULL)
+    {
+      wavetracer = new WindowTracer("wavetracer", waveFile, clockPeriod);
+      wavetracer->trace(sigBusFunction, "bus.Function", 2);
+      wavetracer->trace(sigBusWriter, "bus.Writer", 32);
+      wavetracer->trace(bus.Port_BusAddr, "bus.Addr", 32);
+      for(int i = 0; i < num_procs; i++)
+      {
+        processingUnits[i].trace(*wavetracer);
+      }
 
-    hitRate = 0;
-    missRate = 0;
+      for(size_t i = 0; i < waveWindows.size(); i++)
+      {
+        wavetracer->addWindow(waveWindows[i].first, waveWindows[i].second);
+      }
+      if(waveTriggerLength > 0)
+      {
+        wavetracer->armOnAddress(waveTriggerAddr, config.lineSize - 1, waveTriggerLength);
+      }
+      else if(waveWindows.empty())
+      {
+        wavetracer->addWindow(0, ~(uint64_t) 0);
+      }
+    }
 
-    logger << "[main] " << "hitmissrate defined" << endl;
+    if(statsInterval > 0)
+    {
+      new Periodic("stats_snapshot", statsInterval, take_snapshot);
+    }
+    if(intervalFile != NULL)
+    {
+      // Every 100000 cycles unless a period is given
+      if(intervalCycles == 0 && intervalAccesses == 0)
+      {
+        intervalCycles = 100000;
+      }
+      // Four signature bits per line the caches hold, or per access of an
+      // interval if that is less, so that the signature does not fill up
+      uint64_t lines = (uint64_t) config.sets * config.ways * num_procs;
+      if(intervalAccesses > 0 && intervalAccesses < lines)
+      {
+        lines = intervalAccesses;
+      }
+      uint32_t signatureBits = (uint32_t) min<uint64_t>(max<uint64_t>(4 * lines, 1024), 1u << 24);
+      intervals = new IntervalSampler(intervalFile, statistics, intervalAccesses, config.lineSize,
+                                      phaseThreshold, signatureBits);
+      if(intervalCycles > 0)
+      {
+        new Periodic("interval_timer", intervalCycles, end_interval);
+      }
+    }
 
 
     cout << "Running (press CTRL+C to interrupt)... " << endl;
 
     // Start Simulation
+    double hostStart = host_seconds();
+    HOST_PROFILE_START();
     sc_start();
+    HOST_PROFILE_STOP();
+    double hostTime = host_seconds() - hostStart;
 
     // Print statistics after simulation finished
     stats_print();
     cout << endl;
-    cout << "Avarage mem access time:" << (hitRate + missRate * 100) / (hitRate + missRate) << endl;
+    if(sampler != NULL)
+    {
+      // Timing below only covers the detailed parts of the trace
+      cout << flush;
+      sampler->print();
+      cout << endl;
+      delete sampler;
+    }
+    if(classifyMisses)
+    {
+      vector<const MissClassifier*> classifiers;
+      for(int i = 0; i < num_procs; i++)
+      {
+        classifiers.push_back(processingUnits[i].cache.classifier());
+      }
+      cout << flush;
+      print_miss_classes(classifiers);
+      cout << endl;
+    }
+    cout << "Memory: " << memory.pages() << " pages touched, " << memory.footprint() / 1024 << " KiB" << endl;
+    if(reference != NULL)
+    {
+      cout << "Value check: " << statistics.sum("stale_reads") << " stale reads" << endl;
+    }
+    cout << endl;
+    // Measured from request to completion, over all caches
+    cout << "Avarage mem access time:" << statistics.total("latency").mean() << " cycles" << endl;
     cout << endl;
-    //sc_close_vcd_trace_file(wf);
+
+    // Simulation speed, to compare the thread and method builds
+    double cycles = sc_time_stamp().to_seconds() / clockPeriod.to_seconds();
+    cout << "Simulated cycles: " << (uint64_t) cycles << endl;
+    cout << "Host time: " << hostTime << " s" << endl;
+    cout << "Simulated cycles per host second: " << cycles / hostTime << endl;
+    double accesses = statistics.sum("readhit") + statistics.sum("readmiss") +
+                      statistics.sum("writehit") + statistics.sum("writemiss");
+    cout << "Accesses per host second: " << accesses / hostTime << endl;
+    cout << flush;
+    HOST_PROFILE_PRINT();
+
+    if(statsJson != NULL || statsCsv != NULL)
+    {
+      write_statistics(statsJson, statsCsv);
+    }
+
+    if(intervals != NULL)
+    {
+      intervals->close(current_cycle());
+      cout << "Intervals: " << intervals->intervals() << " intervals, " << intervals->phases() << " phases" << endl;
+      delete intervals;
+    }
+
+    if(bustrace != NULL)
+    {
+      bustrace->close();
+      cout << "Bus trace: " << bustrace->requests() << " requests" << endl;
+      delete bustrace;
+      bustrace = NULL;
+    }
+
+    if(wavetracer != NULL)
+    {
+      wavetracer->close();
+      cout << "Wave trace: " << wavetracer->windows() << " windows" << endl;
+    }
+
+    if(eventlog != NULL)
+    {
+      eventlog->close();
+      cout << "Event log: " << eventlog->size() << " records" << endl;
+      delete eventlog;
+      eventlog = NULL;
+    }
   }
 
   catch (exception& e)
   {
     cerr << e.what() << endl;
+    delete bustrace;    // removes the spill files, writes no bus trace
+    delete eventlog;    // removes the partial event log
+    log_close();
+    return 1;
   }
 
-  logger.close();
-  return 0;
+  log_close();
+  return checkpointMissed ? 1 : 0;
 }
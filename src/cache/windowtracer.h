@@ -0,0 +1,213 @@
+/*
+// File: windowtracer.h
+//
+// Waveform tracer that only records inside time windows. Windows are
+// either given up front as cycle ranges, or opened by an address trigger
+// when a cache sees an access to the armed address. Records go to the
+// compact binary format of wavetrace.h, see src/wave2vcd for conversion.
+//
+// Outside the windows the sampling method waits on an event nobody
+// notifies while the window is closed, so the traced signals do not wake
+// any process and tracing costs nothing.
+*/
+
+#ifndef WINDOWTRACER_H
+#define WINDOWTRACER_H
+
+#include <systemc.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "wavetrace.h"
+
+// Converts a signal value to the integer stored in the trace
+template<typename T>
+inline uint64_t wave_value(const T& v) { return (uint64_t) v; }
+
+template<int W>
+inline uint64_t wave_value(const sc_lv<W>& v) { return v.is_01() ? v.to_uint64() : 0; }
+
+class WindowTracer : public sc_module
+{
+public:
+
+  SC_HAS_PROCESS(WindowTracer);
+
+  WindowTracer(sc_module_name nm, const char* filename, const sc_time& cycle)
+  : sc_module(nm), cycle_(cycle), out_(filename, (uint64_t) (cycle.to_seconds() * 1e12 + 0.5)),
+    open_(false), end_(0), armed_(0), triggerMask_(0), triggerAddr_(0), triggerLength_(0),
+    windows_(0)
+  {
+    SC_METHOD(control);
+
+    SC_METHOD(sample);
+    dont_initialize();
+    sensitive << openEvent_;
+  }
+
+  ~WindowTracer()
+  {
+    for (size_t i = 0; i < probes_.size(); i++) {
+      delete probes_[i];
+    }
+  }
+
+  /* Register a signal, before the simulation starts. */
+  template<typename T>
+  void trace(const sc_signal_in_if<T>& sig, const std::string& name, unsigned width) {
+    probes_.push_back(new SignalProbe<T>(sig));
+    out_.add_signal(name, width);
+    changes_ |= sig.value_changed_event();
+  }
+
+  /* Record the cycles [begin, end). */
+  void addWindow(uint64_t begin, uint64_t end) {
+    if (end > begin) {
+      schedule_.push_back(std::make_pair(begin, end));
+      std::sort(schedule_.begin(), schedule_.end());
+    }
+  }
+
+  /* Open a window of the given length on the next access to the line
+  holding addr, for the given number of times. */
+  void armOnAddress(uint32_t addr, uint32_t lineMask, uint64_t length, int count = 1) {
+    triggerMask_   = ~lineMask;
+    triggerAddr_   = addr & triggerMask_;
+    triggerLength_ = length;
+    armed_         = count;
+  }
+
+  /* Called by the caches on every access. */
+  void access(uint32_t addr) {
+    if (armed_ > 0 && !open_ && (addr & triggerMask_) == triggerAddr_) {
+      armed_--;
+      uint64_t now = cycle();
+      addWindow(now, now + triggerLength_);
+      controlEvent_.notify(SC_ZERO_TIME);
+    }
+  }
+
+  /* Close the current window and the file. */
+  void close() {
+    if (open_) {
+      closeWindow();
+    }
+    out_.close();
+  }
+
+  uint64_t windows() const { return windows_; }
+
+private:
+
+  struct Probe {
+    virtual ~Probe() {}
+    virtual uint64_t value() const = 0;
+  };
+
+  template<typename T>
+  struct SignalProbe : public Probe {
+    const sc_signal_in_if<T>& sig;
+    SignalProbe(const sc_signal_in_if<T>& s) : sig(s) {}
+    uint64_t value() const { return wave_value(sig.read()); }
+  };
+
+  sc_time            cycle_;
+  WaveTraceWriter    out_;
+  std::vector<Probe*>     probes_;
+  std::vector<uint64_t>   last_;
+  sc_event_or_list   changes_;
+  sc_event           openEvent_;
+  sc_event           controlEvent_;
+
+  // Pending windows, sorted on their first cycle
+  std::vector<std::pair<uint64_t, uint64_t> > schedule_;
+
+  bool     open_;
+  uint64_t end_;
+  int      armed_;
+  uint32_t triggerMask_;
+  uint32_t triggerAddr_;
+  uint64_t triggerLength_;
+  uint64_t windows_;
+
+  uint64_t cycle() const {
+    return sc_time_stamp().value() / cycle_.value();
+  }
+
+  void openWindow(uint64_t end) {
+    last_.resize(probes_.size());
+    for (size_t i = 0; i < probes_.size(); i++) {
+      last_[i] = probes_[i]->value();
+    }
+    out_.dump_on(cycle(), last_);
+    open_ = true;
+    end_  = end;
+    windows_++;
+    openEvent_.notify(SC_ZERO_TIME);
+  }
+
+  void closeWindow() {
+    record();
+    out_.dump_off(cycle());
+    open_ = false;
+  }
+
+  /* Record the signals that changed since the last call. */
+  void record() {
+    uint64_t now = cycle();
+    for (size_t i = 0; i < probes_.size(); i++) {
+      uint64_t v = probes_[i]->value();
+      if (v != last_[i]) {
+        out_.change(now, i, v);
+        last_[i] = v;
+      }
+    }
+  }
+
+  /* Opens and closes the windows at their boundaries. */
+  void control() {
+    uint64_t now = cycle();
+
+    if (open_ && now >= end_) {
+      closeWindow();
+    }
+
+    // Drop windows that have passed, open the first one that has begun
+    while (!schedule_.empty() && schedule_.front().first <= now) {
+      uint64_t end = schedule_.front().second;
+      schedule_.erase(schedule_.begin());
+      if (end <= now) {
+        continue;
+      }
+      if (!open_) {
+        openWindow(end);
+      } else if (end > end_) {
+        end_ = end;
+      }
+    }
+
+    // Windows ending at ~0 stay open until the end of the simulation
+    uint64_t next = open_ ? end_ : (schedule_.empty() ? 0 : schedule_.front().first);
+    if (next > now && next != ~(uint64_t) 0) {
+      next_trigger((double) (next - now) * cycle_, controlEvent_);
+    } else {
+      next_trigger(controlEvent_);
+    }
+  }
+
+  /* Follows the signals while a window is open. */
+  void sample() {
+    if (!open_) {
+      next_trigger(openEvent_);
+      return;
+    }
+    record();
+    if (probes_.empty()) {
+      next_trigger(openEvent_);
+    } else {
+      next_trigger(changes_);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+// File: eventlog_reader.cpp
+//
+// Reader for the binary event logs written by the cache simulator with
+// --eventlog. Prints a per-CPU summary of the log, or dumps the records
+// as CSV for further processing.
+//
+// Usage: eventlog_reader [--csv] [--cpu <n>] <eventlog>
+*/
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eventlog.h"
+
+using namespace std;
+
+// Totals per CPU for the summary
+struct CpuSummary
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t hits;
+    uint64_t latency;
+};
+
+static void print_summary(const EventLogReader& log)
+{
+    vector<CpuSummary> cpus;
+    uint64_t first = UINT64_MAX, last = 0;
+
+    // Walk the columns block by block, only touching what we need
+    for (uint32_t b = 0; b < log.num_blocks(); b++)
+    {
+        uint32_t        n       = log.block_size(b);
+        const uint64_t* time    = log.time(b);
+        const uint32_t* latency = log.latency(b);
+        const uint16_t* cpu     = log.cpu(b);
+        const uint8_t*  flags   = log.flags(b);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (cpu[i] >= cpus.size())
+            {
+                CpuSummary empty = { 0, 0, 0, 0 };
+                cpus.resize(cpu[i] + 1, empty);
+            }
+            CpuSummary& s = cpus[cpu[i]];
+            if (flags[i] & EVENT_WRITE)
+                s.writes++;
+            else
+                s.reads++;
+            if (flags[i] & EVENT_HIT)
+                s.hits++;
+            s.latency += latency[i];
+            // Records are appended when the access completes, so they are
+            // not in the order of their start cycles
+            if (time[i] < first)
+                first = time[i];
+            if (time[i] > last)
+                last = time[i];
+        }
+    }
+
+    if (log.size() == 0)
+    {
+        first = 0;
+    }
+    printf("Records: %llu, cycles %llu to %llu\n",
+           (unsigned long long) log.size(), (unsigned long long) first, (unsigned long long) last);
+    printf("CPU\tReads\tWrites\tHits\tMisses\tHitrate\tAvgLat\n");
+    for (size_t i = 0; i < cpus.size(); i++)
+    {
+        const CpuSummary& s = cpus[i];
+        uint64_t accesses = s.reads + s.writes;
+        if (accesses == 0)
+        {
+            continue;
+        }
+        printf("%u\t%llu\t%llu\t%llu\t%llu\t%f\t%f\n", (unsigned) i,
+               (unsigned long long) s.reads, (unsigned long long) s.writes,
+               (unsigned long long) s.hits, (unsigned long long) (accesses - s.hits),
+               100.0 * s.hits / accesses, (double) s.latency / accesses);
+    }
+}
+
+static void print_csv(const EventLogReader& log, int cpu_filter)
+{
+    printf("time,cpu,addr,set,way,hit,write,latency\n");
+    for (uint64_t i = 0; i < log.size(); i++)
+    {
+        EventRecord r;
+        log.get(i, r);
+        if (cpu_filter >= 0 && r.cpu != cpu_filter)
+        {
+            continue;
+        }
+        printf("%llu,%u,0x%08x,%u,%d,%d,%d,%u\n", (unsigned long long) r.time, r.cpu, r.addr,
+               r.set, r.way, (r.flags & EVENT_HIT) ? 1 : 0, (r.flags & EVENT_WRITE) ? 1 : 0,
+               r.latency);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bool        csv        = false;
+    int         cpu_filter = -1;
+    const char* filename   = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv = true;
+        }
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)
+        {
+            cpu_filter = atoi(argv[++i]);
+        }
+        else if (filename == NULL && argv[i][0] != '-')
+        {
+            filename = argv[i];
+        }
+        else
+        {
+            filename = NULL;
+            break;
+        }
+    }
+
+    if (filename == NULL)
+    {
+        fprintf(stderr, "Error, usage: %s [--csv] [--cpu <n>] <eventlog>\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        EventLogReader log(filename);
+        if (csv)
+            print_csv(log, cpu_filter);
+        else
+            print_summary(log);
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+// File: funcsim.cpp
+//
+// Functional (untimed) cache simulator. Streams a 2TRF tracefile through
+// one CacheCore per CPU, without clock, bus or signals, and prints the same
+// per-CPU statistics table as stats_print(). With --check it compares its
+// counts against the output of the SystemC cache simulator for the same
+// tracefile and configuration.
+//
+// Usage: funcsim <tracefile> [--sets <n>] [--ways <n>] [--line <bytes>]
+//                [--policy lru|fifo|plru|random] [--check <cache output>]
+//                [--classify]
+//
+// --classify also sorts the misses into compulsory, capacity and conflict
+// misses, see missclass.h.
+*/
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "functional.h"
+#include "hosttime.h"
+
+using namespace std;
+
+// Compares the counters with the stats_print() table in the given file,
+// returns the number of CPUs that differ
+static int check_stats(const char* filename, const vector<AccessCounters>& stats)
+{
+    FILE* f = fopen(filename, "r");
+    if (f == NULL)
+    {
+        throw runtime_error(string("Unable to open file: ") + filename);
+    }
+
+    char line[512];
+    bool table = false;
+    int  errors = 0;
+    size_t found = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (!table)
+        {
+            table = (strncmp(line, "CPU\tReads\tRHit", 14) == 0);
+            continue;
+        }
+
+        unsigned cpu;
+        unsigned long long reads, rhit, rmiss, writes, whit, wmiss;
+        if (sscanf(line, "%u %llu %llu %llu %llu %llu %llu", &cpu, &reads, &rhit, &rmiss,
+                   &writes, &whit, &wmiss) != 7)
+        {
+            break;
+        }
+        found++;
+        if (cpu >= stats.size())
+        {
+            printf("CPU %u: not in the tracefile\n", cpu);
+            errors++;
+            continue;
+        }
+
+        const AccessCounters& s = stats[cpu];
+        if (rhit != s.readhit || rmiss != s.readmiss || whit != s.writehit || wmiss != s.writemiss)
+        {
+            printf("CPU %u: expected RHit %llu RMiss %llu WHit %llu WMiss %llu, "
+                   "simulated RHit %llu RMiss %llu WHit %llu WMiss %llu\n", cpu,
+                   rhit, rmiss, whit, wmiss,
+                   (unsigned long long) s.readhit, (unsigned long long) s.readmiss,
+                   (unsigned long long) s.writehit, (unsigned long long) s.writemiss);
+            errors++;
+        }
+    }
+    fclose(f);
+
+    if (!table)
+    {
+        throw runtime_error(string("No statistics table in file: ") + filename);
+    }
+    if (found != stats.size())
+    {
+        printf("Expected %u CPUs, found %u\n", (unsigned) stats.size(), (unsigned) found);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* tracefile = NULL;
+    const char* checkfile = NULL;
+    uint32_t    sets = 128, ways = 8, line = 32;
+    string      policy_arg = "lru";
+    bool        classify = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--sets" && i + 1 < argc)
+            sets = strtoul(argv[++i], NULL, 0);
+        else if (opt == "--ways" && i + 1 < argc)
+            ways = strtoul(argv[++i], NULL, 0);
+        else if (opt == "--line" && i + 1 < argc)
+            line = strtoul(argv[++i], NULL, 0);
+        else if (opt == "--policy" && i + 1 < argc)
+            policy_arg = argv[++i];
+        else if (opt == "--check" && i + 1 < argc)
+            checkfile = argv[++i];
+        else if (opt == "--classify")
+            classify = true;
+        else if (tracefile == NULL && opt[0] != '-')
+            tracefile = argv[i];
+        else
+        {
+            tracefile = NULL;
+            break;
+        }
+    }
+
+    if (tracefile == NULL)
+    {
+        fprintf(stderr, "Error, usage: %s <tracefile> [--sets <n>] [--ways <n>] [--line <bytes>] "
+                "[--policy lru|fifo|plru|random] [--check <cache output>] [--classify]\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        ReplacementPolicy      policy = parse_policy(policy_arg);
+        MappedTraceFile        trace(tracefile);
+        vector<CacheCore>      caches(trace.get_proc_count(), CacheCore(sets, ways, line, policy));
+        AccessCounters         zero = { 0, 0, 0, 0 };
+        vector<AccessCounters> stats(trace.get_proc_count(), zero);
+        vector<MissClassifier> classes;
+        if (classify)
+        {
+            classes.assign(trace.get_proc_count(), MissClassifier(sets * ways, line));
+        }
+
+        double start = host_seconds();
+        run_functional(trace, caches, stats, classify ? &classes : NULL);
+        double elapsed = host_seconds() - start;
+
+        uint64_t accesses = 0;
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            accesses += stats[i].readhit + stats[i].readmiss + stats[i].writehit + stats[i].writemiss;
+        }
+
+        print_counters(stats);
+        if (classify)
+        {
+            vector<const MissClassifier*> tables;
+            for (size_t i = 0; i < classes.size(); i++)
+            {
+                tables.push_back(&classes[i]);
+            }
+            printf("\n");
+            print_miss_classes(tables);
+        }
+        printf("\nAccesses: %llu in %f s, %f accesses per second\n",
+               (unsigned long long) accesses, elapsed, accesses / elapsed);
+        printf("Cache metadata: %llu KiB per CPU\n",
+               (unsigned long long) (caches[0].metadata_size() / 1024));
+
+        if (checkfile != NULL)
+        {
+            int errors = check_stats(checkfile, stats);
+            printf("Check against %s: %s\n", checkfile, errors == 0 ? "OK" : "MISMATCH");
+            return errors == 0 ? 0 : 2;
+        }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
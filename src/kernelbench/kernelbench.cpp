@@ -0,0 +1,409 @@
+/*
+// File: kernelbench.cpp
+//
+// Microbenchmarks of the SystemC kernel primitives the simulators are built
+// from, in the style of the tutorial and counter_4bit modules. Every
+// benchmark instantiates <procs> identical processes that together perform
+// <ops> operations, and reports the host time per operation and the delta
+// cycles per operation:
+//
+//   method   SC_METHOD re-triggered every cycle with next_trigger()
+//   thread   SC_THREAD waiting for the next cycle (one context switch)
+//   signal   method writing a changed value to its own sc_signal
+//   buffer   method writing the same value to its own sc_buffer
+//   delta    method sensitive to its own sc_signal, incrementing it in
+//            zero time, so every operation is a process run in a delta
+//   event    method sensitive to its own sc_event, notifying it with
+//            SC_ZERO_TIME
+//   mutex    threads polling one shared sc_mutex with trylock() every
+//            cycle, holding it for a cycle when they get it
+//   rv       methods driving one shared sc_signal_rv<32> as a tristate
+//            bus, one driver per cycle and "Z" from all others
+//
+// The per-cycle benchmarks advance time by 1 ns per cycle. Subtracting the
+// method cost from signal, buffer and rv gives the cost of the write and
+// update alone. Each benchmark and process count runs in a forked child,
+// since SystemC cannot elaborate a new design after sc_start().
+//
+// Usage: kernelbench [--procs 1,4,16,...] [--ops <n>] [--bench name,...]
+*/
+
+#include <systemc.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hosttime.h"
+
+using namespace std;
+
+// Common part of the benchmark processes: the operations left to do
+class Bench : public sc_module
+{
+public:
+    Bench(sc_module_name name, uint64_t ops)
+        : sc_module(name), m_cycle(1, SC_NS), m_ops(ops), m_count(0)
+    {
+    }
+
+    uint64_t count() const { return m_count; }
+
+protected:
+    sc_time  m_cycle;
+    uint64_t m_ops;
+    uint64_t m_count;
+};
+
+class MethodBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(MethodBench);
+
+    MethodBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_METHOD(execute);
+    }
+
+private:
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            next_trigger(m_cycle);
+        }
+    }
+};
+
+class ThreadBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(ThreadBench);
+
+    ThreadBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_THREAD(execute);
+    }
+
+private:
+    void execute()
+    {
+        while (m_count++ < m_ops)
+        {
+            wait(m_cycle);
+        }
+    }
+};
+
+class SignalBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(SignalBench);
+
+    SignalBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_METHOD(execute);
+    }
+
+private:
+    sc_signal<int> m_signal;
+
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            m_signal.write((int) m_count);
+            next_trigger(m_cycle);
+        }
+    }
+};
+
+class BufferBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(BufferBench);
+
+    BufferBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_METHOD(execute);
+    }
+
+private:
+    sc_buffer<int> m_buffer;
+
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            m_buffer.write(1);
+            next_trigger(m_cycle);
+        }
+    }
+};
+
+class DeltaBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(DeltaBench);
+
+    DeltaBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_METHOD(execute);
+        sensitive << m_signal;
+    }
+
+private:
+    sc_signal<int> m_signal;
+
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            m_signal.write(m_signal.read() + 1);
+        }
+    }
+};
+
+class EventBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(EventBench);
+
+    EventBench(sc_module_name name, uint64_t ops) : Bench(name, ops)
+    {
+        SC_METHOD(execute);
+        sensitive << m_event;
+    }
+
+private:
+    sc_event m_event;
+
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            m_event.notify(SC_ZERO_TIME);
+        }
+    }
+};
+
+class MutexBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(MutexBench);
+
+    MutexBench(sc_module_name name, uint64_t ops, sc_mutex& mutex)
+        : Bench(name, ops), m_mutex(mutex)
+    {
+        SC_THREAD(execute);
+    }
+
+private:
+    sc_mutex& m_mutex;
+
+    void execute()
+    {
+        while (m_count++ < m_ops)
+        {
+            if (m_mutex.trylock() == 0)
+            {
+                wait(m_cycle);
+                m_mutex.unlock();
+            }
+            else
+            {
+                wait(m_cycle);
+            }
+        }
+    }
+};
+
+class RvBench : public Bench
+{
+public:
+    SC_HAS_PROCESS(RvBench);
+
+    RvBench(sc_module_name name, uint64_t ops, sc_signal_rv<32>& bus, int id, int drivers)
+        : Bench(name, ops), m_bus(bus), m_id(id), m_drivers(drivers), m_z("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ")
+    {
+        SC_METHOD(execute);
+    }
+
+private:
+    sc_signal_rv<32>& m_bus;
+    int               m_id;
+    int               m_drivers;
+    sc_lv<32>         m_z;
+
+    void execute()
+    {
+        if (m_count++ < m_ops)
+        {
+            // Like the tutorial's data bus: one driver, all others float
+            if ((int) (m_count % m_drivers) == m_id)
+                m_bus.write(sc_lv<32>((int) m_count));
+            else
+                m_bus.write(m_z);
+            next_trigger(m_cycle);
+        }
+    }
+};
+
+static const char* const BENCHMARKS[] = {
+    "method", "thread", "signal", "buffer", "delta", "event", "mutex", "rv"
+};
+static const int NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+// Elaborates and runs one benchmark, prints its result line
+static void run_benchmark(const string& bench, int procs, uint64_t ops)
+{
+    sc_mutex         mutex("mutex");
+    sc_signal_rv<32> bus("bus");
+    vector<Bench*>   units;
+    uint64_t         per_proc = (ops + procs - 1) / procs;
+
+    for (int i = 0; i < procs; i++)
+    {
+        char name[16];
+        sprintf(name, "p%d", i);
+        if (bench == "method")
+            units.push_back(new MethodBench(name, per_proc));
+        else if (bench == "thread")
+            units.push_back(new ThreadBench(name, per_proc));
+        else if (bench == "signal")
+            units.push_back(new SignalBench(name, per_proc));
+        else if (bench == "buffer")
+            units.push_back(new BufferBench(name, per_proc));
+        else if (bench == "delta")
+            units.push_back(new DeltaBench(name, per_proc));
+        else if (bench == "event")
+            units.push_back(new EventBench(name, per_proc));
+        else if (bench == "mutex")
+            units.push_back(new MutexBench(name, per_proc, mutex));
+        else if (bench == "rv")
+            units.push_back(new RvBench(name, per_proc, bus, i, procs));
+        else
+            throw runtime_error("Unknown benchmark: " + bench);
+    }
+
+    double start = host_seconds();
+    sc_start();
+    double seconds = host_seconds() - start;
+
+    // Every process counts one extra run, the one in which it stops
+    uint64_t done = 0;
+    for (size_t i = 0; i < units.size(); i++)
+    {
+        done += units[i]->count() - 1;
+    }
+    printf("%s\t%d\t%llu\t%f\t%f\n", bench.c_str(), procs, (unsigned long long) done,
+           1e9 * seconds / done, (double) sc_delta_count() / done);
+    fflush(stdout);
+}
+
+// Parses a comma separated list
+static vector<string> parse_list(const char* arg)
+{
+    vector<string> values;
+    string s = arg;
+    size_t start = 0;
+    while (start <= s.size())
+    {
+        size_t end = s.find(',', start);
+        if (end == string::npos)
+            end = s.size();
+        values.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return values;
+}
+
+int sc_main(int argc, char* argv[])
+{
+    vector<string> benches(BENCHMARKS, BENCHMARKS + NUM_BENCHMARKS);
+    vector<int>    procs;
+    uint64_t       ops = 1000000;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string opt = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+            if (value == NULL)
+                throw runtime_error("Missing value for " + opt);
+            if (opt == "--procs")
+            {
+                vector<string> list = parse_list(value);
+                for (size_t j = 0; j < list.size(); j++)
+                {
+                    int n = atoi(list[j].c_str());
+                    if (n < 1)
+                        throw runtime_error(string("Invalid process count: ") + value);
+                    procs.push_back(n);
+                }
+            }
+            else if (opt == "--ops")
+                ops = strtoull(value, NULL, 0);
+            else if (opt == "--bench")
+                benches = parse_list(value);
+            else
+                throw runtime_error(string("Error, usage: ") + argv[0] +
+                    " [--procs 1,4,16,...] [--ops n] [--bench name,...]");
+            i++;
+        }
+        if (procs.empty())
+        {
+            for (int n = 1; n <= 256; n *= 4)
+                procs.push_back(n);
+        }
+        if (ops == 0)
+        {
+            throw runtime_error("Invalid operation count");
+        }
+
+        printf("Benchmark\tProcs\tOps\tns/op\tDeltas/op\n");
+        fflush(stdout);
+        for (size_t b = 0; b < benches.size(); b++)
+        {
+            for (size_t p = 0; p < procs.size(); p++)
+            {
+                pid_t pid = fork();
+                if (pid < 0)
+                {
+                    throw runtime_error("Unable to fork");
+                }
+                if (pid == 0)
+                {
+                    int status = 0;
+                    try
+                    {
+                        run_benchmark(benches[b], procs[p], ops);
+                    }
+                    catch (exception& e)
+                    {
+                        fprintf(stderr, "%s\n", e.what());
+                        status = 1;
+                    }
+                    fflush(stdout);
+                    _exit(status);
+                }
+
+                int status;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                {
+                    throw runtime_error("Benchmark " + benches[b] + " failed");
+                }
+            }
+        }
+    }
+    catch (exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
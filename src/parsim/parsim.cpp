@@ -0,0 +1,1399 @@
+/*
+// File: parsim.cpp
+//
+// Parallel timed cache simulator. Models the same CPUs, private caches and
+// shared bus as the SystemC simulator in src/cache, with its cycle costs,
+// but as a plain C++ discrete-event model whose CPUs are split into groups
+// that run on separate host threads.
+//
+// A CPU only depends on the others through the bus, so every group runs
+// its CPUs ahead until each of them either finished its trace or needs the
+// bus. The bus request then goes into the group's lock-free request queue,
+// timestamped with the cycle the cache would try to take the bus. When all
+// groups are blocked, the bus (the main thread) grants the queued requests
+// in timestamp order, one cycle each, and sends the grants back through
+// per-group queues.
+//
+// The bus may only grant a request once no CPU can still issue an earlier
+// one. CPUs waiting for a grant are safe up to their own request. For a
+// CPU granted in this round the bus looks ahead into its trace: hits do
+// not change the cache contents, so the cycle of its next miss, plus the
+// memory latency a read miss spends before it reaches the bus, is known
+// without running it. A round grants every request older than the
+// earliest of these, so the model stays conservative: no request ever
+// reaches the bus after a later one was granted.
+//
+// Such rounds are small: a CPU asks for at most one grant per round, so
+// with 8 CPUs a round grants 5 or 6 requests for two barrier waits, and
+// more threads only add barrier time. Rounds of a fixed number of cycles,
+// the quantum, give them more work. Every CPU runs until its cycle leaves
+// the window, as if the bus granted each of its requests at once, and
+// queues them. Without coherence the bus can do so: a grant only delays
+// the CPU, it does not change what its cache does. The bus then merges
+// the queued requests in cycle order, each delayed by the cycles its CPU
+// already waited, grants those in the window and delays every CPU by its
+// waits. Requests past the window wait for the next round, which may
+// still queue earlier ones, so the result is the same as with rounds of
+// single requests, which --quantum 0 selects.
+//
+// All decisions are taken by the bus in a fixed order, so statistics and
+// cycle counts do not depend on the number of threads.
+//
+// --two-phase splits the run in two. First every CPU runs its whole trace
+// on its own, in parallel, as if it always got the bus at once, and
+// records a stream of its accesses, stamped with its local cycle. Then
+// the bus replays the merged streams in cycle order on one thread,
+// delaying each CPU by the cycles it waits for the bus. Without coherence
+// this gives the same cycles as the default mode.
+//
+// The replay also tracks which lines every cache holds: a write to a line
+// cached elsewhere would invalidate those copies under a snooping
+// protocol. A later hit of that CPU to an invalidated line is a coherence
+// miss; the replay counts it and fetches the line again, so it can be
+// invalidated again. Only the misses, with the line they replace, and the
+// hits that may meet an invalidated copy are recorded: reads of lines
+// that another CPU writes and writes to lines that another CPU touches. A
+// scan of the trace before the first phase finds those lines, and perhaps
+// a few more, see LineOwners. The streams go to a temporary file a chunk
+// at a time, so the memory does not grow with the streams.
+//
+// A coherence miss costs its CPU the memory latency, the longest wait for
+// the bus in the replay and a bus cycle, and every other CPU one cycle, as
+// it may hold up their requests. That is pessimistic about the timing of
+// the extra misses, but it is no strict bound: an invalidation frees a
+// way, so the real run can replace other lines than the replay.
+//
+// Usage: parsim <tracefile> [--threads <n>] [--quantum <cycles>] [--two-phase]
+*/
+
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "functional.h"
+#include "hosttime.h"
+
+using namespace std;
+
+// Cache geometry and timing of src/cache/cache.cpp
+static const int NUM_SETS    = 128;
+static const int NUM_LINES   = 8;
+static const int LINE_SIZE   = 32;
+static const int MEM_LATENCY = 100;
+
+// Trace entries the bus looks ahead into a resumed CPU's trace
+static const int LOOKAHEAD_ENTRIES = 64;
+
+// Lines remembered per CPU by the scan before the first phase
+static const uint32_t SCAN_FILTER = 4096;
+
+// A cache asking for the bus
+struct BusRequest
+{
+    uint64_t cycle;     // first cycle the cache tries to take the bus
+    uint32_t cpu;
+    bool     write;
+
+    bool operator<(const BusRequest& r) const
+    {
+        return cycle != r.cycle ? cycle < r.cycle : cpu < r.cpu;
+    }
+};
+
+// The bus handing out a bus cycle
+struct BusGrant
+{
+    uint64_t cycle;
+    uint32_t cpu;
+};
+
+/*
+ * Bounded single-producer single-consumer queue. The producer only writes
+ * m_tail and the consumer only m_head, each published with release order,
+ * so no locks are needed. Capacity is a power of two.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity = 1) : m_head(0), m_tail(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_items.resize(size);
+        m_mask = size - 1;
+    }
+
+    // Returns false when the queue is full
+    bool push(const T& item)
+    {
+        size_t tail = m_tail;
+        if (tail - __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) > m_mask)
+        {
+            return false;
+        }
+        m_items[tail & m_mask] = item;
+        __atomic_store_n(&m_tail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Returns false when the queue is empty
+    bool pop(T& item)
+    {
+        size_t head = m_head;
+        if (head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
+        {
+            return false;
+        }
+        item = m_items[head & m_mask];
+        __atomic_store_n(&m_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    std::vector<T> m_items;
+    size_t         m_mask;
+    char           m_pad0[64];
+    size_t         m_head;
+    char           m_pad1[64];
+    size_t         m_tail;
+};
+
+// Sense-reversing barrier; spins briefly, then yields the host core
+class Barrier
+{
+public:
+    Barrier(unsigned count) : m_count(count), m_waiting(0), m_generation(0) {}
+
+    void wait()
+    {
+        unsigned generation = __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE);
+        if (__sync_add_and_fetch(&m_waiting, 1) == m_count)
+        {
+            m_waiting = 0;
+            __atomic_store_n(&m_generation, generation + 1, __ATOMIC_RELEASE);
+            return;
+        }
+        for (unsigned spins = 0; __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE) == generation; spins++)
+        {
+            if (spins >= 1000)
+            {
+                sched_yield();
+            }
+        }
+    }
+
+private:
+    unsigned m_count;
+    unsigned m_waiting;
+    unsigned m_generation;
+};
+
+// Accesses recorded by the first phase of --two-phase
+enum BusEventType
+{
+    EVENT_READ_MISS,
+    EVENT_WRITE_MISS,
+    EVENT_READ_HIT,     // no bus transaction, unless the line was invalidated
+    EVENT_WRITE_HIT     // no bus transaction, but invalidates other copies
+};
+
+// Lines are stored by their address, whose low bits are free as in trace
+// entries: they hold the event type in line, and in victim a flag that a
+// valid line was replaced
+struct BusEvent
+{
+    uint64_t cycle;     // local cycle, without waiting for the bus
+    uint32_t line;      // address of the line | type
+    uint32_t victim;    // address of the replaced line | 1, or 0
+};
+
+// Events per chunk of an EventStream
+static const size_t EVENT_CHUNK = 4096;
+
+// Temporary file the CPUs append the chunks of their event streams to
+class EventFile
+{
+public:
+    EventFile() : m_end(0)
+    {
+        m_file = tmpfile();
+        if (m_file == NULL)
+        {
+            throw runtime_error("Unable to create a temporary file");
+        }
+    }
+
+    ~EventFile() { fclose(m_file); }
+
+    // Returns the offset of the data, or -1 when it could not be written.
+    // Several threads may append at once.
+    int64_t append(const void* data, size_t bytes)
+    {
+        uint64_t offset = __sync_fetch_and_add(&m_end, bytes);
+        if (pwrite(fileno(m_file), data, bytes, offset) != (ssize_t) bytes)
+        {
+            return -1;
+        }
+        return offset;
+    }
+
+    bool read(uint64_t offset, void* data, size_t bytes) const
+    {
+        return pread(fileno(m_file), data, bytes, offset) == (ssize_t) bytes;
+    }
+
+private:
+    FILE*    m_file;
+    uint64_t m_end;
+
+    // Private copy constructor because no copies are allowed.
+    EventFile(const EventFile&);
+};
+
+// The events of one CPU, written to an EventFile a chunk at a time and
+// read back the same way, so only a chunk per CPU stays in memory
+class EventStream
+{
+public:
+    EventStream(EventFile& file) : m_file(file), m_count(0), m_failed(false), m_next(0), m_pos(0)
+    {
+        m_chunk.reserve(EVENT_CHUNK);
+    }
+
+    void push(const BusEvent& e)
+    {
+        m_chunk.push_back(e);
+        m_count++;
+        if (m_chunk.size() == EVENT_CHUNK)
+        {
+            flush();
+        }
+    }
+
+    // Ends the writing, next() then returns the events from the first on
+    void rewind()
+    {
+        flush();
+        if (m_failed)
+        {
+            throw runtime_error("Unable to write the event streams");
+        }
+        m_next = 0;
+        m_pos  = 0;
+    }
+
+    // Returns false after the last event
+    bool next(BusEvent& e)
+    {
+        if (m_pos == m_chunk.size())
+        {
+            if (m_next == m_offsets.size())
+            {
+                return false;
+            }
+            size_t n = min((uint64_t) EVENT_CHUNK, m_count - m_next * EVENT_CHUNK);
+            m_chunk.resize(n);
+            if (!m_file.read(m_offsets[m_next++], &m_chunk[0], n * sizeof(BusEvent)))
+            {
+                throw runtime_error("Unable to read the event streams");
+            }
+            m_pos = 0;
+        }
+        e = m_chunk[m_pos++];
+        return true;
+    }
+
+private:
+    EventFile&       m_file;
+    vector<uint64_t> m_offsets;     // of the chunks in the file
+    vector<BusEvent> m_chunk;
+    uint64_t         m_count;
+    bool             m_failed;
+    size_t           m_next;        // chunk to read
+    size_t           m_pos;         // event to read in m_chunk
+
+    void flush()
+    {
+        if (m_chunk.empty())
+        {
+            return;
+        }
+        int64_t offset = m_file.append(&m_chunk[0], m_chunk.size() * sizeof(BusEvent));
+        m_failed = m_failed || offset < 0;
+        m_offsets.push_back(offset);
+        m_chunk.clear();
+    }
+
+    // Private copy constructor because no copies are allowed.
+    EventStream(const EventStream&);
+};
+
+// Owners of the lines in a LineOwners. CPUs past 0xfffd count as many.
+static const uint32_t NO_CPU    = 0xffff;
+static const uint32_t MANY_CPUS = 0xfffe;
+
+// Most buckets of a LineOwners, 32 MB
+static const size_t MAX_OWNER_BUCKETS = 1 << 23;
+
+// Which CPUs touch and which write the lines: a CPU, NO_CPU or MANY_CPUS.
+// The first phase of --two-phase skips the hits to lines no other CPU
+// writes or touches, since they can never meet an invalidated copy.
+//
+// The lines are hashed into a fixed number of buckets of two 16-bit
+// owners, without tags. Lines sharing a bucket share their owners, which
+// can only make the first phase record hits it need not, never miss one.
+class LineOwners
+{
+public:
+    LineOwners() : m_shift(22) {}
+
+    // Sets up buckets for about lines lines, all without owners
+    void reset(uint64_t lines)
+    {
+        size_t size = 1024;
+        m_shift = 22;
+        while (size < lines && size < MAX_OWNER_BUCKETS)
+        {
+            size *= 2;
+            m_shift--;
+        }
+        m_buckets.assign(size, NO_CPU << 16 | NO_CPU);
+    }
+
+    void clear()
+    {
+        vector<uint32_t> empty;
+        m_buckets.swap(empty);
+    }
+
+    // Adds an access of cpu to line, from any thread
+    void add(uint32_t line, uint32_t cpu, bool write)
+    {
+        uint32_t* bucket = &m_buckets[find(line)];
+        uint32_t  owners = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+        while (true)
+        {
+            uint32_t touched = combine(owners & 0xffff, cpu);
+            uint32_t written = write ? combine(owners >> 16, cpu) : owners >> 16;
+            uint32_t updated = written << 16 | touched;
+            if (updated == owners ||
+                __atomic_compare_exchange_n(bucket, &owners, updated, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+    }
+
+    uint32_t touched(uint32_t line) const { return m_buckets[find(line)] & 0xffff; }
+    uint32_t written(uint32_t line) const { return m_buckets[find(line)] >> 16; }
+
+    // The owner a CPU is stored as
+    static uint32_t owner(uint32_t cpu) { return min(cpu, MANY_CPUS); }
+
+private:
+    vector<uint32_t> m_buckets;     // written << 16 | touched
+    uint32_t         m_shift;       // 32 - log2 of the buckets
+
+    // The high bits of a multiplicative hash, so that lines a power of two
+    // apart do not share a bucket
+    size_t find(uint32_t line) const { return (uint32_t) (line * 2654435761u) >> m_shift; }
+
+    static uint32_t combine(uint32_t owners, uint32_t cpu)
+    {
+        cpu = owner(cpu);
+        if (owners == NO_CPU || owners == cpu)
+            return cpu;
+        return MANY_CPUS;
+    }
+};
+
+// No line in a LineHolders, all line numbers are shorter
+static const uint32_t NO_LINE = ~0u;
+
+// CPUs holding each line in the replay of --two-phase, a bit mask per line.
+// Only lines some cache holds have an entry, so the table is bounded by the
+// size of the caches.
+class LineHolders
+{
+public:
+    LineHolders(uint32_t procs) : m_words((procs + 63) / 64), m_size(0)
+    {
+        m_lines.assign(1024, NO_LINE);
+        m_masks.assign(1024 * m_words, 0);
+    }
+
+    // Adds cpu to the holders of line, returns false if it held it already
+    bool insert(uint32_t line, uint32_t cpu)
+    {
+        size_t i = find(line);
+        if (m_lines[i] == NO_LINE)
+        {
+            m_lines[i] = line;
+            m_size++;
+        }
+        uint64_t& word = m_masks[i * m_words + cpu / 64];
+        uint64_t  bit  = 1ULL << (cpu % 64);
+        if (word & bit)
+        {
+            return false;
+        }
+        word |= bit;
+        if (m_size * 2 > m_lines.size())
+        {
+            rehash(m_lines.size() * 2);
+        }
+        return true;
+    }
+
+    // Removes cpu from the holders of line
+    void erase(uint32_t line, uint32_t cpu)
+    {
+        size_t i = find(line);
+        if (m_lines[i] != NO_LINE)
+        {
+            m_masks[i * m_words + cpu / 64] &= ~(1ULL << (cpu % 64));
+            if (empty_mask(i))
+            {
+                remove(i);
+            }
+        }
+    }
+
+    // Removes every holder of line but cpu, counting the copies lost per CPU
+    void invalidate_others(uint32_t line, uint32_t cpu, vector<uint64_t>& lost)
+    {
+        size_t i = find(line);
+        if (m_lines[i] == NO_LINE)
+        {
+            return;
+        }
+        uint64_t* mask = &m_masks[i * m_words];
+        for (uint32_t w = 0; w < m_words; w++)
+        {
+            uint64_t others = mask[w] & ~(w == cpu / 64 ? 1ULL << (cpu % 64) : 0);
+            mask[w] &= ~others;
+            for (; others != 0; others &= others - 1)
+            {
+                lost[w * 64 + __builtin_ctzll(others)]++;
+            }
+        }
+        if (empty_mask(i))
+        {
+            remove(i);
+        }
+    }
+
+private:
+    uint32_t         m_words;   // per mask
+    size_t           m_size;
+    vector<uint32_t> m_lines;
+    vector<uint64_t> m_masks;   // m_words per line
+
+    // Multiplicative, with the high bits folded in, as lines a power of
+    // two apart would share the low bits
+    static size_t hash(uint32_t line)
+    {
+        uint32_t h = line * 2654435761u;
+        return h ^ (h >> 15);
+    }
+
+    // Slot of line, or the empty slot where it would go
+    size_t find(uint32_t line) const
+    {
+        size_t mask = m_lines.size() - 1;
+        size_t i    = hash(line) & mask;
+        while (m_lines[i] != NO_LINE && m_lines[i] != line)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    bool empty_mask(size_t i) const
+    {
+        for (uint32_t w = 0; w < m_words; w++)
+        {
+            if (m_masks[i * m_words + w] != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void move(size_t from, size_t to)
+    {
+        m_lines[to] = m_lines[from];
+        for (uint32_t w = 0; w < m_words; w++)
+        {
+            m_masks[to * m_words + w] = m_masks[from * m_words + w];
+        }
+    }
+
+    // Empties slot i, moving back the lines after it that would no longer
+    // be found, so no deleted markers are needed
+    void remove(size_t i)
+    {
+        size_t mask = m_lines.size() - 1;
+        size_t j    = i;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (m_lines[j] == NO_LINE)
+            {
+                break;
+            }
+            size_t home = hash(m_lines[j]) & mask;
+            bool   stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays)
+            {
+                move(j, i);
+                i = j;
+            }
+        }
+        m_lines[i] = NO_LINE;
+        for (uint32_t w = 0; w < m_words; w++)
+        {
+            m_masks[i * m_words + w] = 0;
+        }
+        m_size--;
+    }
+
+    void rehash(size_t capacity)
+    {
+        vector<uint32_t> lines(capacity, NO_LINE);
+        vector<uint64_t> masks(capacity * m_words, 0);
+        lines.swap(m_lines);
+        masks.swap(m_masks);
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            if (lines[i] != NO_LINE)
+            {
+                size_t k = find(lines[i]);
+                m_lines[k] = lines[i];
+                for (uint32_t w = 0; w < m_words; w++)
+                {
+                    m_masks[k * m_words + w] = masks[i * m_words + w];
+                }
+            }
+        }
+    }
+};
+
+// One simulated processor with its private cache
+struct TimedCpu
+{
+    CacheCore         cache;
+    AccessCounters    stats;
+    uint32_t          pid;
+    uint64_t          next;        // next trace word of this CPU
+    uint64_t          cycle;       // cycle of the next trace entry
+    bool              blocked;     // waiting for a bus grant
+    bool              write;       // kind of the pending bus transaction
+    bool              finished;
+    EventStream*      stream;      // records the transactions, if set
+    vector<BusRequest> window;     // requests of this round, with --quantum
+
+    TimedCpu(uint32_t pid)
+        : cache(NUM_SETS, NUM_LINES, LINE_SIZE), pid(pid), next(pid), cycle(0),
+          blocked(false), write(false), finished(false), stream(NULL)
+    {
+        AccessCounters zero = { 0, 0, 0, 0 };
+        stats = zero;
+    }
+};
+
+// Cycle of a CPU's next trace entry after the bus granted its transaction.
+// A read completes in the bus cycle, a write one cycle later, and the CPU
+// advances one more cycle before fetching.
+static uint64_t resume_cycle(bool write, uint64_t grant)
+{
+    return grant + (write ? 3 : 2);
+}
+
+// A host thread's share of the CPUs
+struct CpuGroup
+{
+    uint32_t                first;
+    uint32_t                last;       // one past the group's last CPU
+    SpscQueue<BusRequest>   requests;   // group to bus
+    SpscQueue<BusGrant>     grants;     // bus to group
+
+    CpuGroup(uint32_t first, uint32_t last)
+        : first(first), last(last), requests(last - first), grants(last - first)
+    {
+    }
+};
+
+class ParallelSim
+{
+public:
+    ParallelSim(const MappedTraceFile& trace, uint32_t threads, uint64_t quantum);
+    ~ParallelSim();
+
+    void run();
+    void run_two_phase();
+    void print() const;
+
+private:
+    const MappedTraceFile&  m_trace;
+    vector<TimedCpu>        m_cpus;
+    vector<CpuGroup*>       m_groups;
+    vector<BusRequest>      m_pending;      // requests not granted yet
+    Barrier                 m_barrier;
+    bool                    m_done;
+    uint64_t                m_quantum;      // cycles per round, 0 if exact
+    uint64_t                m_windowEnd;    // end of the current round
+
+    // Bus state and statistics
+    uint64_t m_busFree;     // first cycle the bus is free
+    uint64_t m_reads;
+    uint64_t m_writes;
+    uint64_t m_waits;       // cycles spent waiting for the bus
+    uint64_t m_rounds;
+    double   m_seconds;
+
+    // Two-phase mode
+    EventFile*                m_eventFile;
+    vector<EventStream*>      m_streams;        // per CPU
+    LineOwners                m_owners;
+    vector<uint64_t>          m_invalidations;  // copies lost per CPU
+    vector<uint64_t>          m_coherenceMisses; // hits to lost copies per CPU
+    uint64_t                  m_maxWait;        // longest wait for the bus
+    double                    m_filterSeconds;  // first phase
+
+    // Runs a CPU until it needs the bus or its trace ends
+    void advance(TimedCpu& cpu);
+
+    // Applies the grants, then advances every CPU of the group
+    void run_group(CpuGroup& group);
+
+    // Earliest cycle a CPU resuming at cycle can ask for the bus again
+    uint64_t lookahead(const TimedCpu& cpu, uint64_t cycle) const;
+
+    // Grants the safe requests, returns false when all CPUs finished
+    bool run_bus();
+
+    // The same for a round of --quantum
+    void run_window(CpuGroup& group);
+    bool run_bus_window();
+
+    // Whether the first phase records a hit of cpu to addr
+    bool shared_hit(const TimedCpu& cpu, uint32_t addr, bool write) const;
+
+    // Before the first phase: adds the accesses of the group's CPUs to
+    // m_owners
+    void scan_group(CpuGroup& group);
+
+    // First phase: runs the group's CPUs to the end, granting every bus
+    // request at once
+    void filter_group(CpuGroup& group);
+
+    // Runs fn for every group, on threads of its own but for the first
+    void run_groups(void* (*fn)(void*));
+
+    // Second phase: merges the streams through the bus
+    void replay();
+
+    static void* worker(void* arg);
+    static void* scan_worker(void* arg);
+    static void* filter_worker(void* arg);
+    struct WorkerArgs
+    {
+        ParallelSim* sim;
+        CpuGroup*    group;
+    };
+};
+
+ParallelSim::ParallelSim(const MappedTraceFile& trace, uint32_t threads, uint64_t quantum)
+    : m_trace(trace), m_barrier(threads + 1), m_done(false), m_quantum(quantum), m_windowEnd(quantum),
+      m_busFree(0), m_reads(0), m_writes(0), m_waits(0), m_rounds(0), m_seconds(0),
+      m_eventFile(NULL), m_maxWait(0), m_filterSeconds(0)
+{
+    uint32_t procs = trace.get_proc_count();
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        m_cpus.push_back(TimedCpu(i));
+    }
+
+    // Contiguous ranges of CPUs, so a group's caches stay on one host core
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        m_groups.push_back(new CpuGroup(t * procs / threads, (t + 1) * procs / threads));
+    }
+}
+
+ParallelSim::~ParallelSim()
+{
+    for (size_t i = 0; i < m_groups.size(); i++)
+    {
+        delete m_groups[i];
+    }
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        delete m_streams[i];
+    }
+    delete m_eventFile;
+}
+
+// Adds an access to the CPU's stream, in the two-phase mode
+static void record(TimedCpu& cpu, BusEventType type, uint32_t addr, const CacheCore::Result& r)
+{
+    if (cpu.stream != NULL)
+    {
+        uint32_t victim = r.evicted ? cpu.cache.address(r.set, r.victim) | 1 : 0;
+        BusEvent e      = { cpu.cycle, (addr & ~(LINE_SIZE - 1)) | type, victim };
+        cpu.stream->push(e);
+    }
+}
+
+void ParallelSim::advance(TimedCpu& cpu)
+{
+    uint32_t         procs = m_trace.get_proc_count();
+    uint64_t         words = m_trace.num_words();
+    TraceFile::Entry e;
+
+    while (!cpu.blocked && !cpu.finished)
+    {
+        if (cpu.next >= words)
+        {
+            cpu.finished = true;
+            break;
+        }
+        m_trace.decode(cpu.next, e);
+        cpu.next += procs;
+
+        CacheCore::Result r;
+        switch (e.type)
+        {
+        case TraceFile::ENTRY_TYPE_READ:
+            if (cpu.cache.access(e.addr, &r))
+            {
+                if (cpu.stream != NULL && shared_hit(cpu, e.addr, false))
+                {
+                    record(cpu, EVENT_READ_HIT, e.addr, r);
+                }
+                cpu.stats.readhit++;
+                cpu.cycle += 1;
+            }
+            else
+            {
+                // The line is fetched from memory before the bus is taken
+                cpu.stats.readmiss++;
+                cpu.cycle  += MEM_LATENCY;
+                cpu.blocked = true;
+                cpu.write   = false;
+                record(cpu, EVENT_READ_MISS, e.addr, r);
+            }
+            break;
+
+        case TraceFile::ENTRY_TYPE_WRITE:
+            if (cpu.cache.access(e.addr, &r))
+            {
+                if (cpu.stream != NULL && shared_hit(cpu, e.addr, true))
+                {
+                    record(cpu, EVENT_WRITE_HIT, e.addr, r);
+                }
+                cpu.stats.writehit++;
+                cpu.cycle += 2;
+            }
+            else
+            {
+                // Writing back the victim of a full set costs a memory access
+                cpu.stats.writemiss++;
+                if (r.entries == cpu.cache.num_ways())
+                {
+                    cpu.cycle += MEM_LATENCY;
+                }
+                cpu.blocked = true;
+                cpu.write   = true;
+                record(cpu, EVENT_WRITE_MISS, e.addr, r);
+            }
+            break;
+
+        case TraceFile::ENTRY_TYPE_END:
+            cpu.finished = true;
+            break;
+
+        default:
+            cpu.cycle += 1;
+            break;
+        }
+    }
+}
+
+void ParallelSim::run_group(CpuGroup& group)
+{
+    if (m_quantum > 0)
+    {
+        run_window(group);
+        return;
+    }
+
+    BusGrant grant;
+    while (group.grants.pop(grant))
+    {
+        TimedCpu& cpu = m_cpus[grant.cpu];
+        cpu.cycle   = resume_cycle(cpu.write, grant.cycle);
+        cpu.blocked = false;
+    }
+
+    for (uint32_t i = group.first; i < group.last; i++)
+    {
+        TimedCpu& cpu = m_cpus[i];
+        if (!cpu.blocked && !cpu.finished)
+        {
+            advance(cpu);
+            if (cpu.blocked)
+            {
+                BusRequest r = { cpu.cycle, i, cpu.write };
+                group.requests.push(r);
+            }
+        }
+    }
+}
+
+uint64_t ParallelSim::lookahead(const TimedCpu& cpu, uint64_t cycle) const
+{
+    // Hits do not change which lines are cached, so up to the first miss
+    // the CPU's path is known without touching its cache
+    uint32_t         procs = m_trace.get_proc_count();
+    uint64_t         words = m_trace.num_words();
+    uint64_t         next  = cpu.next;
+    TraceFile::Entry e;
+
+    for (int i = 0; i < LOOKAHEAD_ENTRIES; i++, next += procs)
+    {
+        if (next >= words)
+        {
+            return UINT64_MAX;
+        }
+        m_trace.decode(next, e);
+
+        uint32_t set = cpu.cache.index(e.addr);
+        bool     hit = cpu.cache.find(set, cpu.cache.tag(e.addr)) >= 0;
+        switch (e.type)
+        {
+        case TraceFile::ENTRY_TYPE_READ:
+            if (!hit)
+                return cycle + MEM_LATENCY;
+            cycle += 1;
+            break;
+
+        case TraceFile::ENTRY_TYPE_WRITE:
+            if (!hit)
+                return cycle + (cpu.cache.entries(set) == cpu.cache.num_ways() ? MEM_LATENCY : 0);
+            cycle += 2;
+            break;
+
+        case TraceFile::ENTRY_TYPE_END:
+            return UINT64_MAX;
+
+        default:
+            cycle += 1;
+            break;
+        }
+    }
+    return cycle;
+}
+
+bool ParallelSim::run_bus()
+{
+    if (m_quantum > 0)
+    {
+        return run_bus_window();
+    }
+
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        BusRequest r;
+        while (m_groups[g]->requests.pop(r))
+        {
+            m_pending.push_back(r);
+        }
+    }
+    if (m_pending.empty())
+    {
+        return false;
+    }
+    m_rounds++;
+    sort(m_pending.begin(), m_pending.end());
+
+    // Every other CPU is blocked or finished, so only the CPUs granted in
+    // this round can still issue requests, none before their lookahead
+    uint64_t horizon = UINT64_MAX;
+    size_t   granted = 0;
+    while (granted < m_pending.size() && (granted == 0 || m_pending[granted].cycle < horizon))
+    {
+        const BusRequest& r = m_pending[granted++];
+        BusGrant g = { max(r.cycle, m_busFree), r.cpu };
+        m_busFree  = g.cycle + 1;
+        m_waits   += g.cycle - r.cycle;
+        (r.write ? m_writes : m_reads)++;
+        horizon = min(horizon, lookahead(m_cpus[r.cpu], resume_cycle(r.write, g.cycle)));
+
+        for (size_t i = 0; i < m_groups.size(); i++)
+        {
+            if (r.cpu >= m_groups[i]->first && r.cpu < m_groups[i]->last)
+            {
+                m_groups[i]->grants.push(g);
+            }
+        }
+    }
+    m_pending.erase(m_pending.begin(), m_pending.begin() + granted);
+    return true;
+}
+
+void ParallelSim::run_window(CpuGroup& group)
+{
+    for (uint32_t i = group.first; i < group.last; i++)
+    {
+        TimedCpu& cpu = m_cpus[i];
+        while (!cpu.finished && cpu.cycle < m_windowEnd)
+        {
+            advance(cpu);
+            if (cpu.blocked)
+            {
+                BusRequest r = { cpu.cycle, i, cpu.write };
+                cpu.window.push_back(r);
+                cpu.cycle   = resume_cycle(cpu.write, cpu.cycle);
+                cpu.blocked = false;
+            }
+        }
+    }
+}
+
+bool ParallelSim::run_bus_window()
+{
+    // Merges the CPUs' requests by the cycle they reach the bus, each
+    // delayed by the cycles its CPU already waited in this round. Requests
+    // past the window wait for the next round, which may still queue
+    // earlier ones, unless every CPU finished.
+    typedef pair<uint64_t, uint32_t> Next;     // bus cycle, CPU
+    priority_queue<Next, vector<Next>, greater<Next> > queue;
+
+    uint32_t         procs   = m_cpus.size();
+    bool             running = false;
+    vector<size_t>   pos(procs, 0);
+    vector<uint64_t> delay(procs, 0);
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        if (!m_cpus[i].window.empty())
+        {
+            queue.push(Next(m_cpus[i].window[0].cycle, i));
+        }
+        running = running || !m_cpus[i].finished;
+    }
+    if (queue.empty() && !running)
+    {
+        return false;
+    }
+    m_rounds++;
+
+    while (!queue.empty() && (!running || queue.top().first < m_windowEnd))
+    {
+        uint64_t cycle = queue.top().first;
+        uint32_t i     = queue.top().second;
+        queue.pop();
+
+        const vector<BusRequest>& w = m_cpus[i].window;
+        uint64_t grant = max(cycle, m_busFree);
+        m_busFree  = grant + 1;
+        m_waits   += grant - cycle;
+        delay[i]  += grant - cycle;
+        (w[pos[i]++].write ? m_writes : m_reads)++;
+
+        if (pos[i] < w.size())
+        {
+            queue.push(Next(w[pos[i]].cycle + delay[i], i));
+        }
+    }
+
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        vector<BusRequest>& w = m_cpus[i].window;
+        w.erase(w.begin(), w.begin() + pos[i]);
+        for (size_t k = 0; k < w.size(); k++)
+        {
+            w[k].cycle += delay[i];
+        }
+        m_cpus[i].cycle += delay[i];
+    }
+    m_windowEnd += m_quantum;
+    return true;
+}
+
+void* ParallelSim::worker(void* arg)
+{
+    WorkerArgs* args = (WorkerArgs*) arg;
+    ParallelSim* sim = args->sim;
+    while (true)
+    {
+        sim->run_group(*args->group);
+        sim->m_barrier.wait();      // groups done, bus runs
+        sim->m_barrier.wait();      // bus done
+        if (__atomic_load_n(&sim->m_done, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+void ParallelSim::run()
+{
+    double start = host_seconds();
+    if (m_groups.size() == 1)
+    {
+        // No threads needed, the groups and the bus take turns
+        do
+        {
+            run_group(*m_groups[0]);
+        } while (run_bus());
+    }
+    else
+    {
+        vector<pthread_t>  threads(m_groups.size());
+        vector<WorkerArgs> args(m_groups.size());
+        for (size_t i = 0; i < m_groups.size(); i++)
+        {
+            args[i].sim   = this;
+            args[i].group = m_groups[i];
+            if (pthread_create(&threads[i], NULL, worker, &args[i]) != 0)
+            {
+                throw runtime_error("Unable to create a thread");
+            }
+        }
+        while (!m_done)
+        {
+            m_barrier.wait();
+            if (!run_bus())
+            {
+                __atomic_store_n(&m_done, true, __ATOMIC_RELEASE);
+            }
+            m_barrier.wait();
+        }
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    m_seconds = host_seconds() - start;
+}
+
+bool ParallelSim::shared_hit(const TimedCpu& cpu, uint32_t addr, bool write) const
+{
+    // Only another CPU's write can invalidate the line, and a write only
+    // invalidates copies of CPUs that touch the line
+    uint32_t line = addr / LINE_SIZE;
+    uint32_t self = LineOwners::owner(cpu.pid);
+    if (write)
+    {
+        return m_owners.touched(line) != self;
+    }
+    uint32_t written = m_owners.written(line);
+    return written != NO_CPU && written != self;
+}
+
+void ParallelSim::scan_group(CpuGroup& group)
+{
+    uint32_t         procs = m_trace.get_proc_count();
+    uint64_t         words = m_trace.num_words();
+    TraceFile::Entry e;
+
+    for (uint32_t i = group.first; i < group.last; i++)
+    {
+        // A line only needs to be added once per CPU, and once more when
+        // it is written. Recent lines are remembered as line * 2 + write,
+        // direct mapped, to skip most repeats.
+        vector<uint32_t> added(SCAN_FILTER, ~0u);
+        for (uint64_t next = i; next < words; next += procs)
+        {
+            m_trace.decode(next, e);
+            if (e.type == TraceFile::ENTRY_TYPE_END)
+            {
+                break;
+            }
+            if (e.type != TraceFile::ENTRY_TYPE_READ && e.type != TraceFile::ENTRY_TYPE_WRITE)
+            {
+                continue;
+            }
+            uint32_t  line  = e.addr / LINE_SIZE;
+            bool      write = (e.type == TraceFile::ENTRY_TYPE_WRITE);
+            uint32_t& slot  = added[line % SCAN_FILTER];
+            if (slot != line * 2 + 1 && (write || slot != line * 2))
+            {
+                m_owners.add(line, i, write);
+                slot = line * 2 + write;
+            }
+        }
+    }
+}
+
+void ParallelSim::filter_group(CpuGroup& group)
+{
+    for (uint32_t i = group.first; i < group.last; i++)
+    {
+        TimedCpu& cpu = m_cpus[i];
+        while (!cpu.finished)
+        {
+            advance(cpu);
+            if (cpu.blocked)
+            {
+                cpu.cycle   = resume_cycle(cpu.write, cpu.cycle);
+                cpu.blocked = false;
+            }
+        }
+    }
+}
+
+void* ParallelSim::scan_worker(void* arg)
+{
+    WorkerArgs* args = (WorkerArgs*) arg;
+    args->sim->scan_group(*args->group);
+    return NULL;
+}
+
+void* ParallelSim::filter_worker(void* arg)
+{
+    WorkerArgs* args = (WorkerArgs*) arg;
+    args->sim->filter_group(*args->group);
+    return NULL;
+}
+
+void ParallelSim::run_groups(void* (*fn)(void*))
+{
+    vector<pthread_t>  threads(m_groups.size());
+    vector<WorkerArgs> args(m_groups.size());
+    for (size_t i = 0; i < m_groups.size(); i++)
+    {
+        args[i].sim   = this;
+        args[i].group = m_groups[i];
+        if (i > 0 && pthread_create(&threads[i], NULL, fn, &args[i]) != 0)
+        {
+            throw runtime_error("Unable to create a thread");
+        }
+    }
+    fn(&args[0]);
+    for (size_t i = 1; i < threads.size(); i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void ParallelSim::replay()
+{
+    typedef pair<uint64_t, uint32_t> Next;     // bus cycle, CPU
+    priority_queue<Next, vector<Next>, greater<Next> > queue;
+
+    uint32_t         procs = m_cpus.size();
+    vector<BusEvent> head(procs);
+    vector<uint64_t> delay(procs, 0);
+    LineHolders      cached(procs);
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        m_streams[i]->rewind();
+        if (m_streams[i]->next(head[i]))
+        {
+            queue.push(Next(head[i].cycle, i));
+        }
+    }
+
+    while (!queue.empty())
+    {
+        uint64_t cycle = queue.top().first;
+        uint32_t i     = queue.top().second;
+        queue.pop();
+
+        const BusEvent& e    = head[i];
+        BusEventType    type = (BusEventType) (e.line & 3);
+        uint32_t        line = e.line / LINE_SIZE;
+        bool            hit  = (type == EVENT_READ_HIT || type == EVENT_WRITE_HIT);
+        if (hit && cached.insert(line, i))
+        {
+            // The line was invalidated since it was filled, fetch it again
+            m_coherenceMisses[i]++;
+        }
+        if (!hit)
+        {
+            uint64_t grant = max(cycle, m_busFree);
+            m_busFree  = grant + 1;
+            m_waits   += grant - cycle;
+            m_maxWait  = max(m_maxWait, grant - cycle);
+            delay[i]  += grant - cycle;
+            (type == EVENT_WRITE_MISS ? m_writes : m_reads)++;
+
+            if (e.victim != 0)
+            {
+                cached.erase(e.victim / LINE_SIZE, i);
+            }
+            cached.insert(line, i);
+        }
+        if (type == EVENT_WRITE_MISS || type == EVENT_WRITE_HIT)
+        {
+            // A snooping protocol would invalidate the other copies
+            cached.invalidate_others(line, i, m_invalidations);
+        }
+
+        if (m_streams[i]->next(head[i]))
+        {
+            queue.push(Next(head[i].cycle + delay[i], i));
+        }
+    }
+
+    for (uint32_t i = 0; i < procs; i++)
+    {
+        m_cpus[i].cycle += delay[i];
+    }
+}
+
+void ParallelSim::run_two_phase()
+{
+    double start = host_seconds();
+    m_owners.reset(m_trace.num_words() / 2);
+    run_groups(scan_worker);
+
+    m_eventFile = new EventFile();
+    m_invalidations.assign(m_cpus.size(), 0);
+    m_coherenceMisses.assign(m_cpus.size(), 0);
+    for (size_t i = 0; i < m_cpus.size(); i++)
+    {
+        m_streams.push_back(new EventStream(*m_eventFile));
+        m_cpus[i].stream = m_streams[i];
+    }
+    run_groups(filter_worker);
+    m_owners.clear();
+    m_filterSeconds = host_seconds() - start;
+
+    replay();
+    m_seconds = host_seconds() - start;
+}
+
+void ParallelSim::print() const
+{
+    vector<AccessCounters> stats;
+    uint64_t cycles   = 0;
+    uint64_t accesses = 0;
+    for (size_t i = 0; i < m_cpus.size(); i++)
+    {
+        const AccessCounters& s = m_cpus[i].stats;
+        stats.push_back(s);
+        cycles    = max(cycles, m_cpus[i].cycle);
+        accesses += s.readhit + s.readmiss + s.writehit + s.writemiss;
+    }
+    print_counters(stats);
+
+    printf("\nBus had %llu reads and %llu writes, %llu cycles waited (%f per access).\n",
+           (unsigned long long) m_reads, (unsigned long long) m_writes, (unsigned long long) m_waits,
+           (double) m_waits / (m_reads + m_writes));
+    if (m_rounds > 0)
+    {
+        printf("Bus rounds: %llu (%f grants per round)\n", (unsigned long long) m_rounds,
+               (double) (m_reads + m_writes) / m_rounds);
+    }
+
+    if (!m_invalidations.empty())
+    {
+        // A coherence miss costs its CPU the memory latency, the longest
+        // wait for the bus seen and the bus cycle instead of a hit, and may
+        // hold up every other CPU for its bus cycle
+        uint64_t total = 0;
+        for (size_t i = 0; i < m_cpus.size(); i++)
+        {
+            total += m_coherenceMisses[i];
+        }
+        printf("\nCoherence (not simulated, pessimistic estimate from the replay):\n");
+        printf("CPU\tInvalidated\tMisses\tExtra cycles\n");
+        uint64_t estimate = cycles;
+        for (size_t i = 0; i < m_cpus.size(); i++)
+        {
+            uint64_t extra = m_coherenceMisses[i] * (MEM_LATENCY + 1 + m_maxWait) +
+                             (total - m_coherenceMisses[i]);
+            printf("%u\t%llu\t%llu\t%llu\n", (unsigned) i, (unsigned long long) m_invalidations[i],
+                   (unsigned long long) m_coherenceMisses[i], (unsigned long long) extra);
+            estimate = max(estimate, m_cpus[i].cycle + extra);
+        }
+        printf("Simulated cycles with coherence misses, at most about: +%llu (%f%%), "
+               "not a strict bound\n", (unsigned long long) (estimate - cycles),
+               100.0 * (estimate - cycles) / cycles);
+    }
+
+    printf("Simulated cycles: %llu\n", (unsigned long long) cycles);
+    if (!m_invalidations.empty())
+    {
+        printf("Host time: %f s, filtering %f s on %u threads, replay %f s\n", m_seconds,
+               m_filterSeconds, (unsigned) m_groups.size(), m_seconds - m_filterSeconds);
+    }
+    else
+    {
+        printf("Host time: %f s on %u threads\n", m_seconds, (unsigned) m_groups.size());
+    }
+    printf("Simulated cycles per host second: %f\n", cycles / m_seconds);
+    printf("Accesses per host second: %f\n", accesses / m_seconds);
+}
+
+int main(int argc, char* argv[])
+{
+    long     threads  = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t quantum  = 10000;
+    bool     twoPhase = false;
+
+    try
+    {
+        if (argc < 2)
+        {
+            throw runtime_error(string("Error, usage: ") + argv[0] +
+                " <tracefile> [--threads n] [--quantum cycles] [--two-phase]");
+        }
+        for (int i = 2; i < argc; i++)
+        {
+            string opt = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+            if (opt == "--two-phase")
+            {
+                twoPhase = true;
+                continue;
+            }
+            if (value == NULL)
+                throw runtime_error("Missing value for " + opt);
+            if (opt == "--threads")
+                threads = atol(value);
+            else if (opt == "--quantum")
+                quantum = strtoull(value, NULL, 0);
+            else
+                throw runtime_error("Unknown option: " + opt);
+            i++;
+        }
+
+        MappedTraceFile trace(argv[1]);
+        if (threads < 1)
+        {
+            threads = 1;
+        }
+        if ((uint32_t) threads > trace.get_proc_count())
+        {
+            threads = trace.get_proc_count();
+        }
+
+        ParallelSim sim(trace, threads, quantum);
+        if (twoPhase)
+            sim.run_two_phase();
+        else
+            sim.run();
+        sim.print();
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
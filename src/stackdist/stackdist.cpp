@@ -0,0 +1,381 @@
+/*
+// File: stackdist.cpp
+//
+// Single-pass LRU stack distance (reuse distance) analysis of a tracefile.
+// The stack distance of an access is the number of distinct lines touched
+// since the previous access to the same line; an LRU cache of C lines hits
+// exactly the accesses with a distance below C. One pass therefore gives
+// the miss ratio of every capacity at once.
+//
+// Distances are computed with the Bennett-Kruskal method: every line is
+// marked at the time of its latest access in a Fenwick tree, so the
+// distance is the number of marks after that time, found in O(log n). The
+// time axis is compacted whenever it fills up, keeping memory proportional
+// to the number of distinct lines.
+//
+// Private caches are analysed per CPU, a shared cache over the global
+// interleaving in which the simulator reads the trace. Set-associative
+// caches are analysed with one stack per set: a cache with S sets and A
+// ways hits exactly the accesses with a per-set distance below A. Only
+// distances up to --max-ways matter there, so each set keeps just its
+// --max-ways most recent lines, and a set gets its stack on its first
+// access. Memory follows the sets the trace touches, not the set count.
+//
+// Usage: stackdist <tracefile> [--line <bytes>] [--sets 1,64,128,...]
+//                  [--max-ways <n>] [--all]
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tracemap.h"
+
+#if __cplusplus >= 201103L
+#include <unordered_map>
+typedef std::unordered_map<uint32_t, uint32_t> LineMap;
+typedef std::unordered_map<uint32_t, std::vector<uint32_t> > SetMap;
+#else
+#include <map>
+typedef std::map<uint32_t, uint32_t> LineMap;
+typedef std::map<uint32_t, std::vector<uint32_t> > SetMap;
+#endif
+
+using namespace std;
+
+// LRU stack distance analyser of one access stream
+class StackAnalyzer
+{
+public:
+    StackAnalyzer() : m_now(0), m_cold(0), m_accesses(0)
+    {
+        m_tree.resize(1024 + 1, 0);
+    }
+
+    // Records an access to line
+    void access(uint32_t line)
+    {
+        if (m_now + 1 >= m_tree.size())
+        {
+            compact();
+        }
+
+        LineMap::iterator p = m_last.find(line);
+        if (p == m_last.end())
+        {
+            m_cold++;
+            m_last[line] = m_now;
+        }
+        else
+        {
+            // Number of distinct lines accessed after the previous access
+            uint64_t d = prefix(m_now) - prefix(p->second + 1);
+            if (d >= m_hist.size())
+            {
+                m_hist.resize(d + 1, 0);
+            }
+            m_hist[d]++;
+            add(p->second, -1);
+            p->second = m_now;
+        }
+        add(m_now, 1);
+        m_now++;
+        m_accesses++;
+    }
+
+    uint64_t accesses() const { return m_accesses; }
+    uint64_t cold() const     { return m_cold; }
+
+    // Accesses with exactly distance d
+    uint64_t histogram(uint64_t d) const { return d < m_hist.size() ? m_hist[d] : 0; }
+
+    // Longest distance seen plus one, the capacity that hits all reuses
+    uint64_t max_distance() const        { return m_hist.size(); }
+
+    // Misses of a fully associative LRU cache of the given number of lines
+    uint64_t misses(uint64_t lines) const
+    {
+        uint64_t hits = 0;
+        for (uint64_t d = 0; d < lines && d < m_hist.size(); d++)
+        {
+            hits += m_hist[d];
+        }
+        return m_accesses - hits;
+    }
+
+private:
+    LineMap          m_last;     // time of the latest access per line
+    vector<uint32_t> m_tree;     // Fenwick tree over time, 1-based
+    uint32_t         m_now;
+    uint64_t         m_cold;
+    uint64_t         m_accesses;
+    vector<uint64_t> m_hist;
+
+    void add(uint32_t t, int v)
+    {
+        for (uint32_t i = t + 1; i < m_tree.size(); i += i & -i)
+        {
+            m_tree[i] += v;
+        }
+    }
+
+    // Number of marks at times below t
+    uint32_t prefix(uint32_t t) const
+    {
+        uint32_t sum = 0;
+        for (uint32_t i = t; i > 0; i -= i & -i)
+        {
+            sum += m_tree[i];
+        }
+        return sum;
+    }
+
+    // Renumbers the latest accesses to 0..n-1 in time order, growing the
+    // tree if it would stay more than half full
+    void compact()
+    {
+        uint32_t         n = m_last.size();
+        vector<uint32_t> line_at(m_now, 0);
+        vector<char>     live(m_now, 0);
+        for (LineMap::const_iterator p = m_last.begin(); p != m_last.end(); ++p)
+        {
+            line_at[p->second] = p->first;
+            live[p->second] = 1;
+        }
+
+        size_t size = m_tree.size() - 1;
+        while (n * 2 >= size)
+        {
+            size *= 2;
+        }
+        m_tree.assign(size + 1, 0);
+
+        uint32_t t = 0;
+        for (uint32_t old = 0; old < m_now; old++)
+        {
+            if (live[old])
+            {
+                m_last[line_at[old]] = t;
+                add(t, 1);
+                t++;
+            }
+        }
+        m_now = t;
+    }
+};
+
+// LRU stacks of the sets of one set-associative cache, cut at max_ways
+// lines: a deeper reuse misses in every associativity analysed anyway
+class SetStacks
+{
+public:
+    SetStacks(uint32_t sets, uint32_t max_ways)
+        : m_mask(sets - 1), m_max_ways(max_ways), m_accesses(0), m_hist(max_ways, 0)
+    {
+    }
+
+    // Records an access to line
+    void access(uint32_t line)
+    {
+        vector<uint32_t>& stack = m_sets[line & m_mask];   // most recent first
+        size_t            d     = find(stack.begin(), stack.end(), line) - stack.begin();
+        if (d < stack.size())
+        {
+            m_hist[d]++;
+            stack.erase(stack.begin() + d);
+        }
+        else if (stack.size() == m_max_ways)
+        {
+            stack.pop_back();
+        }
+        stack.insert(stack.begin(), line);
+        m_accesses++;
+    }
+
+    uint64_t accesses() const { return m_accesses; }
+
+    // Misses with the given number of ways, up to max_ways
+    uint64_t misses(uint32_t ways) const
+    {
+        uint64_t hits = 0;
+        for (uint32_t d = 0; d < ways && d < m_max_ways; d++)
+        {
+            hits += m_hist[d];
+        }
+        return m_accesses - hits;
+    }
+
+private:
+    SetMap           m_sets;     // stack per touched set
+    uint32_t         m_mask;
+    uint32_t         m_max_ways;
+    uint64_t         m_accesses;
+    vector<uint64_t> m_hist;     // accesses per per-set distance
+};
+
+// Parses a comma separated list of numbers
+static vector<uint32_t> parse_list(const char* arg)
+{
+    vector<uint32_t> values;
+    const char* p = arg;
+    while (*p != '\0')
+    {
+        char* end;
+        unsigned long v = strtoul(p, &end, 0);
+        if (end == p || (*end != ',' && *end != '\0') || v == 0 || (v & (v - 1)) != 0)
+        {
+            throw runtime_error(string("Invalid list of powers of two: ") + arg);
+        }
+        values.push_back(v);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+// Prints the miss ratio curve of a fully associative cache
+static void print_curve(const char* title, const StackAnalyzer& a, uint32_t line_size, bool all)
+{
+    printf("\n%s: %llu accesses, %llu compulsory misses, %llu lines cover all reuse\n", title,
+           (unsigned long long) a.accesses(), (unsigned long long) a.cold(),
+           (unsigned long long) a.max_distance());
+    printf("Lines\tBytes\tMisses\tMissRate\n");
+
+    // Walk the capacities in order, accumulating hits
+    uint64_t hits = 0;
+    uint64_t next = 1;
+    for (uint64_t lines = 1; lines <= a.max_distance() + 1; lines++)
+    {
+        hits += a.histogram(lines - 1);
+        if (all || lines == next || lines == a.max_distance() + 1)
+        {
+            uint64_t misses = a.accesses() - hits;
+            printf("%llu\t%llu\t%llu\t%f\n", (unsigned long long) lines,
+                   (unsigned long long) lines * line_size, (unsigned long long) misses,
+                   a.accesses() ? 100.0 * misses / a.accesses() : 0.0);
+        }
+        if (lines == next)
+        {
+            next *= 2;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char*      tracefile = NULL;
+    uint32_t         line_size = 32;
+    uint32_t         max_ways  = 16;
+    bool             all       = false;
+    vector<uint32_t> set_counts;
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string opt = argv[i];
+            if (opt == "--line" && i + 1 < argc)
+                line_size = strtoul(argv[++i], NULL, 0);
+            else if (opt == "--sets" && i + 1 < argc)
+                set_counts = parse_list(argv[++i]);
+            else if (opt == "--max-ways" && i + 1 < argc)
+                max_ways = strtoul(argv[++i], NULL, 0);
+            else if (opt == "--all")
+                all = true;
+            else if (tracefile == NULL && opt[0] != '-')
+                tracefile = argv[i];
+            else
+                throw runtime_error("Unknown option: " + opt);
+        }
+        if (tracefile == NULL)
+        {
+            throw runtime_error(string("Error, usage: ") + argv[0] +
+                " <tracefile> [--line <bytes>] [--sets 1,64,128] [--max-ways <n>] [--all]");
+        }
+        if (line_size == 0 || (line_size & (line_size - 1)) != 0)
+        {
+            throw runtime_error("Line size must be a power of two");
+        }
+        if (max_ways == 0)
+        {
+            throw runtime_error("The number of ways must be positive");
+        }
+        uint32_t line_bits = 0;
+        while ((1u << line_bits) < line_size)
+        {
+            line_bits++;
+        }
+
+        MappedTraceFile trace(tracefile);
+        uint32_t procs = trace.get_proc_count();
+
+        vector<StackAnalyzer> percpu(procs);
+        StackAnalyzer         global;
+
+        // Stacks per set, for every set count and CPU
+        vector<vector<SetStacks> > persets(set_counts.size());
+        for (size_t s = 0; s < set_counts.size(); s++)
+        {
+            persets[s].resize(procs, SetStacks(set_counts[s], max_ways));
+        }
+
+        // Read the trace in the order the simulator does, one entry per CPU
+        TraceFile::Entry e = { TraceFile::ENTRY_TYPE_NOP, 0 };
+        while (!trace.eof())
+        {
+            for (uint32_t pid = 0; pid < procs; pid++)
+            {
+                trace.next(pid, e);
+                if (e.type == TraceFile::ENTRY_TYPE_NOP)
+                {
+                    continue;
+                }
+                uint32_t line = e.addr >> line_bits;
+                percpu[pid].access(line);
+                global.access(line);
+                for (size_t s = 0; s < set_counts.size(); s++)
+                {
+                    persets[s][pid].access(line);
+                }
+            }
+        }
+
+        char title[64];
+        for (uint32_t pid = 0; pid < procs; pid++)
+        {
+            sprintf(title, "CPU %u, fully associative", pid);
+            print_curve(title, percpu[pid], line_size, all);
+        }
+        print_curve("All CPUs, shared fully associative", global, line_size, all);
+
+        // Private set-associative caches, misses summed over the CPUs
+        for (size_t s = 0; s < set_counts.size(); s++)
+        {
+            printf("\n%u sets of %u byte lines, private caches\n", set_counts[s], line_size);
+            printf("Ways\tBytes\tMisses\tMissRate\n");
+            uint64_t accesses = 0;
+            for (uint32_t pid = 0; pid < procs; pid++)
+            {
+                accesses += persets[s][pid].accesses();
+            }
+            for (uint32_t ways = 1; ways <= max_ways; ways++)
+            {
+                uint64_t misses = 0;
+                for (uint32_t pid = 0; pid < procs; pid++)
+                {
+                    misses += persets[s][pid].misses(ways);
+                }
+                printf("%u\t%llu\t%llu\t%f\n", ways,
+                       (unsigned long long) set_counts[s] * ways * line_size,
+                       (unsigned long long) misses, accesses ? 100.0 * misses / accesses : 0.0);
+            }
+        }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,409 @@
+/*
+// File: sweep.cpp
+//
+// Design-space exploration driver. Runs the functional cache model over
+// the cross product of the given tracefiles, cache geometries and
+// replacement policies, fanning the points out over forked worker
+// processes. The tracefiles are mapped once before forking, so all workers
+// share a single copy of every trace. Results are collected in shared
+// memory and written as one CSV and/or JSON table.
+//
+// Usage: sweep [--sets 64,128,...] [--ways 1,2,4,8,...] [--line 32,64,...]
+//              [--policy lru,fifo,plru,random] [--jobs <n>]
+//              [--csv <file>] [--json <file>] <tracefile>...
+//
+// Without --csv or --json the CSV table is written to stdout. Points that
+// fail, through an invalid geometry or a worker that died, carry an error
+// and make the sweep exit non-zero.
+*/
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "functional.h"
+#include "hosttime.h"
+
+using namespace std;
+
+// One point of the grid
+struct SweepPoint
+{
+    uint32_t          trace;
+    uint32_t          sets;
+    uint32_t          ways;
+    uint32_t          line;
+    ReplacementPolicy policy;
+};
+
+// Outcome of a point, written by the workers into shared memory
+struct SweepResult
+{
+    uint32_t started;
+    uint32_t done;
+    uint64_t reads;
+    uint64_t readhits;
+    uint64_t writes;
+    uint64_t writehits;
+    double   seconds;
+    char     error[96];
+};
+
+// Shared between the parent and the workers
+struct SweepShared
+{
+    uint32_t    next;           // next point to take
+    SweepResult results[1];     // one per point
+};
+
+// Parses a comma separated list of numbers
+static vector<uint32_t> parse_list(const char* arg)
+{
+    vector<uint32_t> values;
+    const char* p = arg;
+    while (*p != '\0')
+    {
+        char* end;
+        unsigned long v = strtoul(p, &end, 0);
+        if (end == p || (*end != ',' && *end != '\0'))
+        {
+            throw runtime_error(string("Invalid list: ") + arg);
+        }
+        values.push_back(v);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static vector<ReplacementPolicy> parse_policies(const char* arg)
+{
+    vector<ReplacementPolicy> values;
+    string s = arg;
+    size_t start = 0;
+    while (start <= s.size())
+    {
+        size_t end = s.find(',', start);
+        if (end == string::npos)
+            end = s.size();
+        values.push_back(parse_policy(s.substr(start, end - start)));
+        start = end + 1;
+    }
+    return values;
+}
+
+static void run_point(const SweepPoint& p, const MappedTraceFile& trace, SweepResult& r)
+{
+    try
+    {
+        double start = host_seconds();
+        uint32_t procs = trace.get_proc_count();
+        vector<CacheCore>      caches(procs, CacheCore(p.sets, p.ways, p.line, p.policy));
+        AccessCounters         zero = { 0, 0, 0, 0 };
+        vector<AccessCounters> stats(procs, zero);
+        run_functional(trace, caches, stats);
+
+        for (uint32_t i = 0; i < procs; i++)
+        {
+            r.reads     += stats[i].readhit + stats[i].readmiss;
+            r.readhits  += stats[i].readhit;
+            r.writes    += stats[i].writehit + stats[i].writemiss;
+            r.writehits += stats[i].writehit;
+        }
+        r.seconds = host_seconds() - start;
+    }
+    catch (exception& e)
+    {
+        strncpy(r.error, e.what(), sizeof(r.error) - 1);
+    }
+    r.done = 1;
+}
+
+// Worker loop: takes points until there are none left
+static void worker(SweepShared* shared, const vector<SweepPoint>& points,
+                   const vector<MappedTraceFile*>& traces)
+{
+    while (true)
+    {
+        uint32_t i = __sync_fetch_and_add(&shared->next, 1);
+        if (i >= points.size())
+        {
+            break;
+        }
+        shared->results[i].started = 1;
+        run_point(points[i], *traces[points[i].trace], shared->results[i]);
+    }
+}
+
+// Gives the points no worker finished an error, returns the number of
+// points that failed
+static size_t check_results(SweepShared* shared, size_t points)
+{
+    size_t failed = 0;
+    for (size_t i = 0; i < points; i++)
+    {
+        SweepResult& r = shared->results[i];
+        if (!r.done)
+        {
+            strcpy(r.error, r.started ? "worker died" : "not run");
+        }
+        if (r.error[0] != '\0')
+        {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+// Quotes a CSV field if needed
+static string csv_field(const char* s)
+{
+    if (strpbrk(s, ",\"\n") == NULL)
+    {
+        return s;
+    }
+    string out = "\"";
+    for (; *s != '\0'; s++)
+    {
+        out += (*s == '"') ? "\"\"" : string(1, *s);
+    }
+    return out + "\"";
+}
+
+// Escapes a JSON string value
+static string json_string(const char* s)
+{
+    string out;
+    for (; *s != '\0'; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            out += '\\';
+            out += *s;
+        }
+        else if ((unsigned char) *s < 0x20)
+        {
+            char buf[8];
+            sprintf(buf, "\\u%04x", (unsigned char) *s);
+            out += buf;
+        }
+        else
+        {
+            out += *s;
+        }
+    }
+    return out;
+}
+
+static double hitrate(const SweepResult& r)
+{
+    uint64_t accesses = r.reads + r.writes;
+    return accesses == 0 ? 0 : 100.0 * (r.readhits + r.writehits) / accesses;
+}
+
+static void write_csv(FILE* f, const vector<SweepPoint>& points, const SweepShared* shared,
+                      const vector<const char*>& names)
+{
+    fprintf(f, "trace,sets,ways,line,policy,size,reads,readhits,writes,writehits,hitrate,seconds,error\n");
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const SweepPoint&  p = points[i];
+        const SweepResult& r = shared->results[i];
+        fprintf(f, "%s,%u,%u,%u,%s,%llu,%llu,%llu,%llu,%llu,%f,%f,%s\n", csv_field(names[p.trace]).c_str(),
+                p.sets, p.ways, p.line, policy_name(p.policy),
+                (unsigned long long) p.sets * p.ways * p.line,
+                (unsigned long long) r.reads, (unsigned long long) r.readhits,
+                (unsigned long long) r.writes, (unsigned long long) r.writehits,
+                hitrate(r), r.seconds, csv_field(r.error).c_str());
+    }
+}
+
+static void write_json(FILE* f, const vector<SweepPoint>& points, const SweepShared* shared,
+                       const vector<const char*>& names)
+{
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const SweepPoint&  p = points[i];
+        const SweepResult& r = shared->results[i];
+        fprintf(f, "  {\"trace\": \"%s\", \"sets\": %u, \"ways\": %u, \"line\": %u, \"policy\": \"%s\", "
+                "\"size\": %llu, \"reads\": %llu, \"readhits\": %llu, \"writes\": %llu, "
+                "\"writehits\": %llu, \"hitrate\": %f, \"seconds\": %f, \"error\": \"%s\"}%s\n",
+                json_string(names[p.trace]).c_str(), p.sets, p.ways, p.line, policy_name(p.policy),
+                (unsigned long long) p.sets * p.ways * p.line,
+                (unsigned long long) r.reads, (unsigned long long) r.readhits,
+                (unsigned long long) r.writes, (unsigned long long) r.writehits,
+                hitrate(r), r.seconds, json_string(r.error).c_str(),
+                (i + 1 < points.size()) ? "," : "");
+    }
+    fprintf(f, "]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    vector<uint32_t>          sets(1, 128), ways(1, 8), lines(1, 32);
+    vector<ReplacementPolicy> policies(1, REPL_LRU);
+    vector<const char*>       names;
+    const char*               csvfile  = NULL;
+    const char*               jsonfile = NULL;
+    long                      jobs     = sysconf(_SC_NPROCESSORS_ONLN);
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string opt = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+            if (opt[0] != '-')
+            {
+                names.push_back(argv[i]);
+                continue;
+            }
+            if (value == NULL)
+                throw runtime_error("Missing value for " + opt);
+            if (opt == "--sets")
+                sets = parse_list(value);
+            else if (opt == "--ways")
+                ways = parse_list(value);
+            else if (opt == "--line")
+                lines = parse_list(value);
+            else if (opt == "--policy")
+                policies = parse_policies(value);
+            else if (opt == "--jobs")
+                jobs = atol(value);
+            else if (opt == "--csv")
+                csvfile = value;
+            else if (opt == "--json")
+                jsonfile = value;
+            else
+                throw runtime_error("Unknown option: " + opt);
+            i++;
+        }
+        if (names.empty())
+        {
+            throw runtime_error(string("Error, usage: ") + argv[0] +
+                " [--sets a,b] [--ways a,b] [--line a,b] [--policy lru,fifo,plru,random]"
+                " [--jobs n] [--csv file] [--json file] <tracefile>...");
+        }
+        if (jobs < 1)
+        {
+            jobs = 1;
+        }
+
+        // Map every trace once, the workers inherit the mappings
+        vector<MappedTraceFile*> traces;
+        for (size_t t = 0; t < names.size(); t++)
+        {
+            traces.push_back(new MappedTraceFile(names[t]));
+        }
+
+        vector<SweepPoint> points;
+        for (size_t t = 0; t < names.size(); t++)
+            for (size_t s = 0; s < sets.size(); s++)
+                for (size_t w = 0; w < ways.size(); w++)
+                    for (size_t l = 0; l < lines.size(); l++)
+                        for (size_t p = 0; p < policies.size(); p++)
+                        {
+                            SweepPoint point = { (uint32_t) t, sets[s], ways[w], lines[l], policies[p] };
+                            points.push_back(point);
+                        }
+
+        size_t size = sizeof(SweepShared) + points.size() * sizeof(SweepResult);
+        void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            throw runtime_error("Unable to allocate shared memory");
+        }
+        memset(mem, 0, size);
+        SweepShared* shared = (SweepShared*) mem;
+
+        if ((size_t) jobs > points.size())
+        {
+            jobs = points.size();
+        }
+        fprintf(stderr, "Sweeping %u points over %ld processes\n", (unsigned) points.size(), jobs);
+
+        double start = host_seconds();
+        vector<pid_t> children;
+        for (long j = 0; j < jobs; j++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                worker(shared, points, traces);
+                _exit(0);
+            }
+            if (pid < 0)
+            {
+                perror("fork");
+                break;
+            }
+            children.push_back(pid);
+        }
+        if (children.empty())
+        {
+            // Could not fork at all, do the work here
+            worker(shared, points, traces);
+        }
+        for (size_t j = 0; j < children.size(); j++)
+        {
+            int status;
+            if (waitpid(children[j], &status, 0) < 0)
+            {
+                perror("waitpid");
+            }
+            else if (WIFSIGNALED(status))
+            {
+                fprintf(stderr, "Worker %d killed by signal %d\n", (int) children[j], WTERMSIG(status));
+            }
+            else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                fprintf(stderr, "Worker %d failed\n", (int) children[j]);
+            }
+        }
+        size_t failed = check_results(shared, points.size());
+        fprintf(stderr, "Done in %f s\n", host_seconds() - start);
+
+        if (csvfile == NULL && jsonfile == NULL)
+        {
+            write_csv(stdout, points, shared, names);
+        }
+        if (csvfile != NULL)
+        {
+            FILE* f = fopen(csvfile, "w");
+            if (f == NULL)
+                throw runtime_error(string("Unable to create file: ") + csvfile);
+            write_csv(f, points, shared, names);
+            fclose(f);
+        }
+        if (jsonfile != NULL)
+        {
+            FILE* f = fopen(jsonfile, "w");
+            if (f == NULL)
+                throw runtime_error(string("Unable to create file: ") + jsonfile);
+            write_json(f, points, shared, names);
+            fclose(f);
+        }
+
+        munmap(mem, size);
+        for (size_t t = 0; t < traces.size(); t++)
+        {
+            delete traces[t];
+        }
+        if (failed > 0)
+        {
+            fprintf(stderr, "%u of %u points failed\n", (unsigned) failed, (unsigned) points.size());
+            return 1;
+        }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
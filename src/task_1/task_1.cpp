@@ -31,13 +31,12 @@
 */
 
 #include "aca2009.h"
+#include "backingstore.h"
 #include <systemc.h>
 #include <iostream>
 
 using namespace std;
 
-static const int MEM_SIZE = 512;
-
 SC_MODULE(Memory)
 {
 
@@ -65,17 +64,11 @@ public:
         SC_THREAD(execute);
         sensitive << Port_CLK.pos();
         dont_initialize();
-
-        m_data = new int[MEM_SIZE];
-    }
-
-    ~Memory()
-    {
-        delete[] m_data;
     }
 
 private:
-    int* m_data;
+    // Sparse over the whole address space, so any trace address is kept
+    BackingStore m_data;
 
     void execute()
     {
@@ -101,17 +94,14 @@ private:
 
             if (f == FUNC_READ)
             {
-                Port_Data.write( (addr < MEM_SIZE) ? m_data[addr] : 0 );
+                Port_Data.write( m_data.read_word(addr) );
                 Port_Done.write( RET_READ_DONE );
                 wait();
                 Port_Data.write("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ");
             }
             else
             {
-                if (addr < MEM_SIZE)
-                {
-                    m_data[addr] = data;
-                }
+                m_data.write_word(addr, data);
                 Port_Done.write( RET_WRITE_DONE );
             }
         }
@@ -0,0 +1,395 @@
+/*
+// File: tracegen.cpp
+//
+// Synthetic workload generator. Writes a 2TRF tracefile of --entries
+// entries per CPU for up to 256 CPUs, row by row through a TraceWriter, so
+// traces of many GB are streamed out without being held in memory.
+//
+// Like the CPU of the tutorial, every CPU draws a read or a write and an
+// address per entry, here from one of these patterns:
+//
+//   uniform     random words of one region shared by all CPUs, as the
+//               tutorial does
+//   zipf        lines of a private region, ranked by popularity with a
+//               Zipf distribution of exponent --alpha: a hot set
+//   stride      sweep over a private region in steps of --stride bytes
+//   prodcons    CPUs in pairs: the even CPU writes a ring buffer
+//               sequentially, the odd CPU reads the same words --lag
+//               entries later
+//   falseshare  every CPU uses its own word, but the words of up to eight
+//               CPUs share each line of a small region
+//
+// Regions are --size bytes (per CPU for the private patterns), by default
+// 1 MiB, or eight lines for falseshare. --writes sets the fraction of
+// writes (prodcons ignores it), --nops the fraction of NOP entries. Every
+// CPU has its own random generator seeded from --seed, so a trace is
+// reproducible for any CPU count.
+//
+// Usage: tracegen <output> [--cpus <n>] [--entries <n>] [--pattern <name>]
+//                 [--size <bytes>] [--writes <fraction>] [--nops <fraction>]
+//                 [--alpha <x>] [--stride <bytes>] [--lag <entries>]
+//                 [--seed <n>]
+*/
+
+#include <math.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tracewriter.h"
+#include "hosttime.h"
+
+using namespace std;
+
+static const uint32_t MAX_CPUS  = 256;
+static const uint32_t LINE_SIZE = 32;
+static const uint32_t WORD_SIZE = 4;
+
+enum Pattern
+{
+    PATTERN_UNIFORM,
+    PATTERN_ZIPF,
+    PATTERN_STRIDE,
+    PATTERN_PRODCONS,
+    PATTERN_FALSESHARE
+};
+
+static Pattern parse_pattern(const string& name)
+{
+    if (name == "uniform")    return PATTERN_UNIFORM;
+    if (name == "zipf")       return PATTERN_ZIPF;
+    if (name == "stride")     return PATTERN_STRIDE;
+    if (name == "prodcons")   return PATTERN_PRODCONS;
+    if (name == "falseshare") return PATTERN_FALSESHARE;
+    throw runtime_error("Unknown pattern: " + name);
+}
+
+// xorshift64* generator, one per CPU
+class Random
+{
+public:
+    Random(uint64_t seed) : m_state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint64_t next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) { return next() % n; }
+
+private:
+    uint64_t m_state;
+};
+
+/*
+ * Zipf distribution over the ranks 1..n, P(k) proportional to k^-s, drawn
+ * by rejection-inversion (Hormann and Derflinger, 1996) in constant time
+ * and memory, so hot sets can span any number of lines.
+ */
+class ZipfDistribution
+{
+public:
+    ZipfDistribution(uint64_t n, double s) : m_n(n), m_s(s)
+    {
+        m_hX1 = h_integral(1.5) - 1.0;
+        m_hN  = h_integral(n + 0.5);
+        m_t   = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    uint64_t sample(Random& random) const
+    {
+        while (true)
+        {
+            double   u = m_hN + random.uniform() * (m_hX1 - m_hN);
+            double   x = h_integral_inverse(u);
+            uint64_t k = (uint64_t) (x + 0.5);
+            if (k < 1)
+                k = 1;
+            else if (k > m_n)
+                k = m_n;
+            if (k - x <= m_t || u >= h_integral(k + 0.5) - h((double) k))
+            {
+                return k;
+            }
+        }
+    }
+
+private:
+    uint64_t m_n;
+    double   m_s;
+    double   m_hX1;
+    double   m_hN;
+    double   m_t;
+
+    double h(double x) const { return exp(-m_s * log(x)); }
+
+    double h_integral(double x) const
+    {
+        double lx = log(x);
+        return helper2((1.0 - m_s) * lx) * lx;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = x * (1.0 - m_s);
+        if (t < -1.0)
+        {
+            t = -1.0;
+        }
+        return exp(helper1(t) * x);
+    }
+
+    // log(1 + x) / x and (exp(x) - 1) / x, accurate near 0
+    static double helper1(double x)
+    {
+        return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x)
+    {
+        return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+struct GeneratorConfig
+{
+    Pattern  pattern;
+    uint32_t cpus;
+    uint64_t entries;
+    uint64_t size;
+    double   writes;
+    double   nops;
+    double   alpha;
+    uint64_t stride;
+    uint64_t lag;
+    uint64_t seed;
+};
+
+// Produces the entries of one CPU
+class CpuGenerator
+{
+public:
+    CpuGenerator(const GeneratorConfig& config, uint32_t cpu, const ZipfDistribution* zipf)
+        : m_config(config), m_cpu(cpu), m_random(config.seed * MAX_CPUS + cpu), m_zipf(zipf), m_count(0)
+    {
+        // Private regions follow each other, producer/consumer pairs and
+        // groups of false sharers share theirs
+        switch (config.pattern)
+        {
+        case PATTERN_UNIFORM:    m_base = 0; break;
+        case PATTERN_PRODCONS:   m_base = (cpu / 2) * config.size; break;
+        case PATTERN_FALSESHARE: m_base = (cpu / (LINE_SIZE / WORD_SIZE)) * config.size; break;
+        default:                 m_base = cpu * config.size; break;
+        }
+    }
+
+    void next(TraceFile::EntryType& type, uint32_t& addr)
+    {
+        uint64_t k = m_count++;
+        if (m_config.nops > 0 && m_random.uniform() < m_config.nops)
+        {
+            type = TraceFile::ENTRY_TYPE_NOP;
+            addr = 0;
+            return;
+        }
+
+        bool     write  = m_random.uniform() < m_config.writes;
+        uint64_t offset = 0;
+        switch (m_config.pattern)
+        {
+        case PATTERN_UNIFORM:
+            offset = m_random.below(m_config.size / WORD_SIZE) * WORD_SIZE;
+            break;
+
+        case PATTERN_ZIPF:
+            offset = (m_zipf->sample(m_random) - 1) * LINE_SIZE + m_random.below(LINE_SIZE / WORD_SIZE) * WORD_SIZE;
+            break;
+
+        case PATTERN_STRIDE:
+            offset = (k * m_config.stride) % m_config.size;
+            break;
+
+        case PATTERN_PRODCONS:
+            if (m_cpu % 2 == 0)
+            {
+                write = true;
+            }
+            else if (k >= m_config.lag)
+            {
+                write = false;
+                k -= m_config.lag;
+            }
+            else
+            {
+                // Nothing produced yet
+                type = TraceFile::ENTRY_TYPE_NOP;
+                addr = 0;
+                return;
+            }
+            offset = (k * WORD_SIZE) % m_config.size;
+            break;
+
+        case PATTERN_FALSESHARE:
+            offset = (k * LINE_SIZE) % m_config.size + (m_cpu % (LINE_SIZE / WORD_SIZE)) * WORD_SIZE;
+            break;
+        }
+
+        type = write ? TraceFile::ENTRY_TYPE_WRITE : TraceFile::ENTRY_TYPE_READ;
+        addr = (uint32_t) (m_base + offset);
+    }
+
+private:
+    const GeneratorConfig&  m_config;
+    uint32_t                m_cpu;
+    Random                  m_random;
+    const ZipfDistribution* m_zipf;
+    uint64_t                m_count;
+    uint64_t                m_base;
+};
+
+// Highest address a configuration can produce, plus one
+static uint64_t address_space(const GeneratorConfig& c)
+{
+    switch (c.pattern)
+    {
+    case PATTERN_UNIFORM:    return c.size;
+    case PATTERN_PRODCONS:   return ((c.cpus + 1) / 2) * c.size;
+    case PATTERN_FALSESHARE: return ((c.cpus + 7) / 8) * c.size;
+    default:                 return c.cpus * c.size;
+    }
+}
+
+// Parses the value of a real-valued option
+static double parse_number(const string& opt, const char* value)
+{
+    char*  end;
+    double v = strtod(value, &end);
+    if (end == value || *end != '\0')
+    {
+        throw runtime_error("Invalid value for " + opt + ": " + value);
+    }
+    return v;
+}
+
+int main(int argc, char* argv[])
+{
+    GeneratorConfig config;
+    config.pattern = PATTERN_UNIFORM;
+    config.cpus    = 4;
+    config.entries = 100000;
+    config.size    = 1 << 20;
+    config.writes  = 0.5;
+    config.nops    = 0;
+    config.alpha   = 0.99;
+    config.stride  = LINE_SIZE;
+    config.lag     = 256;
+    config.seed    = 1;
+    bool sizeGiven = false;
+
+    try
+    {
+        if (argc < 2 || argv[1][0] == '-')
+        {
+            throw runtime_error(string("Error, usage: ") + argv[0] +
+                " <output> [--cpus n] [--entries n] [--pattern uniform|zipf|stride|prodcons|falseshare]"
+                " [--size bytes] [--writes x] [--nops x] [--alpha x] [--stride bytes] [--lag n] [--seed n]");
+        }
+        for (int i = 2; i < argc; i++)
+        {
+            string opt = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+            if (value == NULL)
+                throw runtime_error("Missing value for " + opt);
+            if (opt == "--cpus")
+                config.cpus = atoi(value);
+            else if (opt == "--entries")
+                config.entries = strtoull(value, NULL, 0);
+            else if (opt == "--pattern")
+                config.pattern = parse_pattern(value);
+            else if (opt == "--size")
+            {
+                config.size = strtoull(value, NULL, 0);
+                sizeGiven = true;
+            }
+            else if (opt == "--writes")
+                config.writes = parse_number(opt, value);
+            else if (opt == "--nops")
+                config.nops = parse_number(opt, value);
+            else if (opt == "--alpha")
+                config.alpha = parse_number(opt, value);
+            else if (opt == "--stride")
+                config.stride = strtoull(value, NULL, 0);
+            else if (opt == "--lag")
+                config.lag = strtoull(value, NULL, 0);
+            else if (opt == "--seed")
+                config.seed = strtoull(value, NULL, 0);
+            else
+                throw runtime_error("Unknown option: " + opt);
+            i++;
+        }
+
+        if (config.pattern == PATTERN_FALSESHARE && !sizeGiven)
+        {
+            config.size = 8 * LINE_SIZE;
+        }
+        if (config.cpus < 1 || config.cpus > MAX_CPUS)
+            throw runtime_error("The number of CPUs must be between 1 and 256");
+        if (config.size < LINE_SIZE || config.size % LINE_SIZE != 0)
+            throw runtime_error("The region size must be a multiple of the line size");
+        if (config.stride == 0 || config.stride % WORD_SIZE != 0)
+            throw runtime_error("The stride must be a multiple of the word size");
+        if (!(config.alpha > 0))
+            throw runtime_error("The Zipf exponent must be positive");
+        if (!(config.writes >= 0 && config.writes <= 1))
+            throw runtime_error("The write fraction must be between 0 and 1");
+        if (!(config.nops >= 0 && config.nops <= 1))
+            throw runtime_error("The NOP fraction must be between 0 and 1");
+        if (address_space(config) > (1ULL << 32))
+            throw runtime_error("The regions do not fit in the 32-bit address space");
+
+        ZipfDistribution zipf(config.size / LINE_SIZE, config.alpha);
+        vector<CpuGenerator*> cpus;
+        for (uint32_t i = 0; i < config.cpus; i++)
+        {
+            cpus.push_back(new CpuGenerator(config, i, &zipf));
+        }
+
+        double      start = host_seconds();
+        TraceWriter out(argv[1], config.cpus);
+        for (uint64_t row = 0; row < config.entries; row++)
+        {
+            for (uint32_t i = 0; i < config.cpus; i++)
+            {
+                TraceFile::EntryType type;
+                uint32_t             addr;
+                cpus[i]->next(type, addr);
+                out.write(type, addr);
+            }
+        }
+        out.end();
+        out.close();
+
+        double seconds = host_seconds() - start;
+        printf("Wrote %llu entries for %u CPUs (%.1f MB) in %f s\n", (unsigned long long) out.entries(),
+               config.cpus, (8 + 4.0 * out.entries()) / 1e6, seconds);
+
+        for (uint32_t i = 0; i < config.cpus; i++)
+        {
+            delete cpus[i];
+        }
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
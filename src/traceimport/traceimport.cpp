@@ -0,0 +1,394 @@
+/*
+// File: traceimport.cpp
+//
+// Converts memory traces of other tools into 2TRF tracefiles. Inputs are
+// read sequentially in fixed-size chunks and every thread's accesses go to
+// their own stream of a StreamTraceWriter, so traces of any length are
+// converted in constant memory at the speed of the disk.
+//
+// Formats:
+//
+//   lackey    the text output of valgrind --tool=lackey --trace-mem=yes:
+//             "I addr,size", " L addr,size", " S addr,size" and
+//             " M addr,size" (a read followed by a write). A line may start
+//             with a decimal thread id. Valgrind's "==pid==" messages and
+//             other unrecognised lines are skipped and counted.
+//   pin       binary records of a pin tool, 16 bytes each, little-endian:
+//             uint64 address, uint32 thread id, uint8 write flag,
+//             uint8 size and two reserved bytes
+//   champsim  ChampSim instruction records, 64 bytes each: the source memory
+//             operands become reads, the destination operands writes.
+//             ChampSim traces hold a single thread, so every input file is
+//             one thread. Decompress them into the pipe, e.g.
+//             xz -dc trace.champsimtrace.xz | traceimport champsim out.trf -
+//
+// Threads become CPUs in the order they first appear, or fold onto --cpus
+// CPUs round-robin. Addresses are truncated to 32 bits, and an access that
+// crosses a cache line becomes one entry per line. With --instructions every
+// instruction without a memory access adds a NOP, so a CPU spends a cycle
+// on it.
+//
+// Usage: traceimport <lackey|pin|champsim> <output> <input|->...
+//                    [--cpus <n>] [--instructions]
+*/
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tracewriter.h"
+#include "hosttime.h"
+
+using namespace std;
+
+static const uint32_t MAX_CPUS  = 256;
+static const uint32_t LINE_SIZE = 32;
+
+// Bytes per fread of the binary formats
+static const size_t CHUNK_SIZE = 1 << 20;
+
+static const size_t PIN_RECORD_SIZE      = 16;
+static const size_t CHAMPSIM_RECORD_SIZE = 64;
+
+enum Format
+{
+    FORMAT_LACKEY,
+    FORMAT_PIN,
+    FORMAT_CHAMPSIM
+};
+
+static Format parse_format(const string& name)
+{
+    if (name == "lackey")   return FORMAT_LACKEY;
+    if (name == "pin")      return FORMAT_PIN;
+    if (name == "champsim") return FORMAT_CHAMPSIM;
+    throw runtime_error("Unknown format: " + name);
+}
+
+static uint64_t load_le(const unsigned char* p, unsigned bytes)
+{
+    uint64_t value = 0;
+    for (unsigned i = bytes; i > 0; i--)
+    {
+        value = (value << 8) | p[i - 1];
+    }
+    return value;
+}
+
+// Maps the threads of the inputs onto the streams of the output
+class Importer
+{
+public:
+    Importer(const char* output, uint32_t cpus, bool instructions)
+        : m_out(output), m_cpus(cpus), m_instructions(instructions),
+          m_reads(0), m_writes(0), m_nops(0), m_skipped(0), m_bytes(0)
+    {
+    }
+
+    // A memory access of size bytes by thread tid of input file
+    void access(uint32_t file, uint64_t tid, TraceFile::EntryType type, uint64_t addr, uint32_t size)
+    {
+        uint32_t cpu  = map_thread(file, tid);
+        uint64_t line = addr / LINE_SIZE;
+        uint64_t last = (addr + (size > 0 ? size - 1 : 0)) / LINE_SIZE;
+        m_out.write(cpu, type, (uint32_t) addr);
+        for (line++; line <= last; line++)
+        {
+            m_out.write(cpu, type, (uint32_t) (line * LINE_SIZE));
+        }
+        (type == TraceFile::ENTRY_TYPE_WRITE ? m_writes : m_reads) += 1 + last - addr / LINE_SIZE;
+    }
+
+    // An instruction without memory accesses
+    void instruction(uint32_t file, uint64_t tid)
+    {
+        uint32_t cpu = map_thread(file, tid);
+        if (m_instructions)
+        {
+            m_out.write(cpu, TraceFile::ENTRY_TYPE_NOP);
+            m_nops++;
+        }
+    }
+
+    void skipped()                { m_skipped++; }
+    void consumed(uint64_t bytes) { m_bytes += bytes; }
+
+    void close() { m_out.close(); }
+
+    void print(double seconds) const
+    {
+        printf("Threads\t\t%llu\n", (unsigned long long) m_threads.size());
+        printf("CPUs\t\t%u\n", m_out.get_proc_count());
+        printf("Reads\t\t%llu\n", (unsigned long long) m_reads);
+        printf("Writes\t\t%llu\n", (unsigned long long) m_writes);
+        printf("NOPs\t\t%llu\n", (unsigned long long) m_nops);
+        printf("Skipped\t\t%llu\n", (unsigned long long) m_skipped);
+        printf("Imported %.1f MB in %f s (%.1f MB/s)\n", m_bytes / 1e6, seconds,
+               seconds > 0 ? m_bytes / 1e6 / seconds : 0.0);
+    }
+
+private:
+    typedef map<pair<uint32_t, uint64_t>, uint32_t> ThreadMap;
+
+    StreamTraceWriter m_out;
+    uint32_t          m_cpus;
+    bool              m_instructions;
+    ThreadMap         m_threads;
+    uint64_t          m_reads;
+    uint64_t          m_writes;
+    uint64_t          m_nops;
+    uint64_t          m_skipped;
+    uint64_t          m_bytes;
+
+    uint32_t map_thread(uint32_t file, uint64_t tid)
+    {
+        ThreadMap::iterator p = m_threads.find(make_pair(file, tid));
+        if (p != m_threads.end())
+        {
+            return p->second;
+        }
+
+        uint32_t thread = m_threads.size();
+        if (m_cpus == 0 && thread >= MAX_CPUS)
+        {
+            throw runtime_error("More than 256 threads, fold them with --cpus");
+        }
+        uint32_t cpu = (m_cpus == 0) ? thread : thread % m_cpus;
+        m_threads.insert(make_pair(make_pair(file, tid), cpu));
+        return cpu;
+    }
+};
+
+static void import_lackey(FILE* input, uint32_t file, Importer& importer)
+{
+    char line[256];
+    while (fgets(line, sizeof line, input) != NULL)
+    {
+        size_t length = strlen(line);
+        importer.consumed(length);
+        if (length == sizeof line - 1 && line[length - 1] != '\n')
+        {
+            // Overlong line, skip the rest of it
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n')
+            {
+                importer.consumed(1);
+            }
+            importer.skipped();
+            continue;
+        }
+
+        char*    p   = line;
+        uint64_t tid = 0;
+        if (isdigit((unsigned char) *p))
+        {
+            tid = strtoull(p, &p, 10);
+        }
+        while (*p == ' ' || *p == '\t')
+        {
+            p++;
+        }
+
+        char kind = *p++;
+        if ((kind != 'I' && kind != 'L' && kind != 'S' && kind != 'M') || (*p != ' ' && *p != '\t'))
+        {
+            importer.skipped();
+            continue;
+        }
+        char*    end;
+        uint64_t addr = strtoull(p, &end, 16);
+        if (end == p || *end != ',')
+        {
+            importer.skipped();
+            continue;
+        }
+        uint32_t size = strtoul(end + 1, NULL, 10);
+
+        switch (kind)
+        {
+        case 'I': importer.instruction(file, tid); break;
+        case 'L': importer.access(file, tid, TraceFile::ENTRY_TYPE_READ, addr, size); break;
+        case 'S': importer.access(file, tid, TraceFile::ENTRY_TYPE_WRITE, addr, size); break;
+        case 'M':
+            importer.access(file, tid, TraceFile::ENTRY_TYPE_READ, addr, size);
+            importer.access(file, tid, TraceFile::ENTRY_TYPE_WRITE, addr, size);
+            break;
+        }
+    }
+}
+
+// Reads fixed-size records in chunks and passes each to decode
+template <typename Decode>
+static void import_records(FILE* input, size_t record_size, Decode& decode, Importer& importer)
+{
+    vector<unsigned char> chunk(CHUNK_SIZE - CHUNK_SIZE % record_size);
+    size_t                used = 0;
+    size_t                n;
+    while ((n = fread(&chunk[used], 1, chunk.size() - used, input)) > 0)
+    {
+        importer.consumed(n);
+        used += n;
+        size_t records = used / record_size;
+        for (size_t i = 0; i < records; i++)
+        {
+            decode(&chunk[i * record_size]);
+        }
+
+        // Keep a partial record for the next read
+        size_t rest = used - records * record_size;
+        memmove(&chunk[0], &chunk[records * record_size], rest);
+        used = rest;
+    }
+    if (used > 0)
+    {
+        importer.skipped();
+    }
+}
+
+struct PinDecoder
+{
+    uint32_t  file;
+    Importer& importer;
+
+    PinDecoder(uint32_t f, Importer& i) : file(f), importer(i) {}
+
+    void operator()(const unsigned char* r)
+    {
+        uint64_t addr  = load_le(r, 8);
+        uint32_t tid   = load_le(r + 8, 4);
+        bool     write = r[12] != 0;
+        importer.access(file, tid, write ? TraceFile::ENTRY_TYPE_WRITE : TraceFile::ENTRY_TYPE_READ, addr, r[13]);
+    }
+};
+
+// ChampSim's input_instr: uint64 ip, uint8 is_branch, uint8 branch_taken,
+// uint8 destination_registers[2], uint8 source_registers[4],
+// uint64 destination_memory[2], uint64 source_memory[4]
+struct ChampSimDecoder
+{
+    uint32_t  file;
+    Importer& importer;
+
+    ChampSimDecoder(uint32_t f, Importer& i) : file(f), importer(i) {}
+
+    void operator()(const unsigned char* r)
+    {
+        bool memory = false;
+        for (unsigned i = 0; i < 4; i++)
+        {
+            uint64_t addr = load_le(r + 32 + 8 * i, 8);
+            if (addr != 0)
+            {
+                importer.access(file, 0, TraceFile::ENTRY_TYPE_READ, addr, 1);
+                memory = true;
+            }
+        }
+        for (unsigned i = 0; i < 2; i++)
+        {
+            uint64_t addr = load_le(r + 16 + 8 * i, 8);
+            if (addr != 0)
+            {
+                importer.access(file, 0, TraceFile::ENTRY_TYPE_WRITE, addr, 1);
+                memory = true;
+            }
+        }
+        if (!memory)
+        {
+            importer.instruction(file, 0);
+        }
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    uint32_t cpus         = 0;
+    bool     instructions = false;
+
+    try
+    {
+        if (argc < 4)
+        {
+            throw runtime_error(string("Error, usage: ") + argv[0] +
+                " <lackey|pin|champsim> <output> <input|->... [--cpus n] [--instructions]");
+        }
+        Format format = parse_format(argv[1]);
+
+        vector<const char*> inputs;
+        for (int i = 3; i < argc; i++)
+        {
+            string opt = argv[i];
+            if (opt.compare(0, 2, "--") != 0)
+            {
+                inputs.push_back(argv[i]);
+                continue;
+            }
+            if (opt == "--instructions")
+            {
+                instructions = true;
+                continue;
+            }
+            const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+            if (value == NULL)
+                throw runtime_error("Missing value for " + opt);
+            if (opt == "--cpus")
+                cpus = atoi(value);
+            else
+                throw runtime_error("Unknown option: " + opt);
+            i++;
+        }
+        if (inputs.empty())
+            throw runtime_error("No input files");
+        if (cpus > MAX_CPUS)
+            throw runtime_error("The number of CPUs must be between 1 and 256");
+
+        double   start = host_seconds();
+        Importer importer(argv[2], cpus, instructions);
+        for (uint32_t i = 0; i < inputs.size(); i++)
+        {
+            bool  std_in = strcmp(inputs[i], "-") == 0;
+            FILE* input  = std_in ? stdin : fopen(inputs[i], "rb");
+            if (input == NULL)
+            {
+                throw runtime_error(string("Unable to open file: ") + inputs[i]);
+            }
+
+            if (format == FORMAT_LACKEY)
+            {
+                import_lackey(input, i, importer);
+            }
+            else if (format == FORMAT_PIN)
+            {
+                PinDecoder decode(i, importer);
+                import_records(input, PIN_RECORD_SIZE, decode, importer);
+            }
+            else
+            {
+                ChampSimDecoder decode(i, importer);
+                import_records(input, CHAMPSIM_RECORD_SIZE, decode, importer);
+            }
+
+            bool failed = ferror(input) != 0;
+            if (!std_in)
+            {
+                fclose(input);
+            }
+            if (failed)
+            {
+                throw runtime_error(string("Unable to read file: ") + inputs[i]);
+            }
+        }
+        importer.close();
+        importer.print(host_seconds() - start);
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -31,9 +31,11 @@
 */
 
 #include <systemc.h>
+#include "backingstore.h"
 
 using namespace std;
 
+// Words the CPU picks its addresses from
 static const int MEM_SIZE = 512;
 
 SC_MODULE(Memory)
@@ -63,17 +65,11 @@ public:
         SC_THREAD(execute);
         sensitive << Port_CLK.pos();
         dont_initialize();
-
-        m_data = new int[MEM_SIZE];
-    }
-
-    ~Memory()
-    {
-        delete[] m_data;
     }
 
 private:
-    int* m_data;
+    // Sparse over the whole address space, so any trace address is kept
+    BackingStore m_data;
 
     void execute()
     {
@@ -94,15 +90,14 @@ private:
 
             if (f == FUNC_READ)
             {
-                Port_Data.write( (addr < MEM_SIZE) ? m_data[addr] : 0 );
+                Port_Data.write( m_data.read_word(addr) );
                 Port_Done.write( RET_READ_DONE );
                 wait();
                 Port_Data.write("ZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZZ");
             }
             else
             {
-                if (addr < MEM_SIZE)
-                    m_data[addr] = data;
+                m_data.write_word(addr, data);
 
                 Port_Done.write( RET_WRITE_DONE );
             }
@@ -133,7 +128,7 @@ private:
         while(true)
         {
             Memory::Function f = (rand() % 10) < 5 ? Memory::FUNC_READ : Memory::FUNC_WRITE;
-            int addr           = (rand() % MEM_SIZE);;
+            int addr           = (rand() % MEM_SIZE) * 4;
             int data;
 
             Port_MemAddr.write(addr);
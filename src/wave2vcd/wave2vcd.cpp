@@ -0,0 +1,157 @@
+/*
+// File: wave2vcd.cpp
+//
+// Converts the compact binary wave traces written by the cache simulator
+// with --wavetrace into VCD files for waveform viewers. Signal names of
+// the form "module.signal" are placed in a scope per module. Windows are
+// mapped onto $dumpon/$dumpoff, so signals show as 'x' between windows.
+//
+// Usage: wave2vcd <wavetrace> <vcdfile>
+*/
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include "wavetrace.h"
+
+using namespace std;
+
+// Short printable VCD identifier for signal i
+static string vcd_id(uint32_t i)
+{
+    string id;
+    do
+    {
+        id += (char) ('!' + i % 94);
+        i /= 94;
+    } while (i > 0);
+    return id;
+}
+
+static void write_value(FILE* out, const WaveSignal& s, const string& id, uint64_t value)
+{
+    if (s.width <= 1)
+    {
+        fprintf(out, "%d%s\n", (int) (value & 1), id.c_str());
+        return;
+    }
+    char bits[65];
+    int  n = 0;
+    for (int b = s.width - 1; b >= 0; b--)
+    {
+        // Leading zeroes may be left out
+        if (n == 0 && b > 0 && !((value >> b) & 1))
+            continue;
+        bits[n++] = ((value >> b) & 1) ? '1' : '0';
+    }
+    bits[n] = '\0';
+    fprintf(out, "b%s %s\n", bits, id.c_str());
+}
+
+static void write_unknown(FILE* out, const WaveSignal& s, const string& id)
+{
+    if (s.width <= 1)
+        fprintf(out, "x%s\n", id.c_str());
+    else
+        fprintf(out, "bx %s\n", id.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Error, usage: %s <wavetrace> <vcdfile>\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        WaveTraceReader in(argv[1]);
+        FILE* out = fopen(argv[2], "w");
+        if (out == NULL)
+        {
+            throw runtime_error(string("Unable to create file: ") + argv[2]);
+        }
+
+        const vector<WaveSignal>& signals = in.signals();
+        vector<string> ids(signals.size());
+
+        // Group the signals per scope
+        map<string, vector<uint32_t> > scopes;
+        for (uint32_t i = 0; i < signals.size(); i++)
+        {
+            ids[i] = vcd_id(i);
+            size_t dot = signals[i].name.rfind('.');
+            string scope = (dot == string::npos) ? "" : signals[i].name.substr(0, dot);
+            scopes[scope].push_back(i);
+        }
+
+        fprintf(out, "$timescale 1 ps $end\n");
+        fprintf(out, "$scope module top $end\n");
+        for (map<string, vector<uint32_t> >::const_iterator p = scopes.begin(); p != scopes.end(); ++p)
+        {
+            if (!p->first.empty())
+                fprintf(out, "$scope module %s $end\n", p->first.c_str());
+            for (size_t j = 0; j < p->second.size(); j++)
+            {
+                const WaveSignal& s = signals[p->second[j]];
+                size_t dot = s.name.rfind('.');
+                string name = (dot == string::npos) ? s.name : s.name.substr(dot + 1);
+                fprintf(out, "$var wire %u %s %s $end\n", s.width, ids[p->second[j]].c_str(), name.c_str());
+            }
+            if (!p->first.empty())
+                fprintf(out, "$upscope $end\n");
+        }
+        fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+
+        WaveRecord r;
+        uint64_t   time     = 0;
+        bool       has_time = false;
+        size_t     pending  = 0;     // values left of a $dumpon section
+        uint64_t   windows  = 0;
+        while (in.next(r))
+        {
+            if (!has_time || r.time != time)
+            {
+                time = r.time;
+                has_time = true;
+                fprintf(out, "#%llu\n", (unsigned long long) (time * in.timescale_ps()));
+            }
+
+            switch (r.type)
+            {
+            case WAVE_DUMPON:
+                fprintf(out, "$dumpon\n");
+                pending = signals.size();
+                windows++;
+                if (pending == 0)
+                    fprintf(out, "$end\n");
+                break;
+
+            case WAVE_DUMPOFF:
+                fprintf(out, "$dumpoff\n");
+                for (uint32_t i = 0; i < signals.size(); i++)
+                    write_unknown(out, signals[i], ids[i]);
+                fprintf(out, "$end\n");
+                break;
+
+            case WAVE_CHANGE:
+                write_value(out, signals[r.id], ids[r.id], r.value);
+                if (pending > 0 && --pending == 0)
+                    fprintf(out, "$end\n");
+                break;
+            }
+        }
+
+        fclose(out);
+        printf("Converted %u signals in %llu windows\n", (unsigned) signals.size(), (unsigned long long) windows);
+    }
+    catch (exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}